@@ -10,6 +10,10 @@
 #include <vector>
 #include <algorithm>
 #include <mutex>
+#include <array>
+#include <atomic>
+#include <iomanip>
+#include <string>
 using namespace std;
 
 
@@ -204,6 +208,269 @@ public:
     }
 };
 
+// Lamport's fast mutual exclusion lock
+// without contention a thread enters after 5 accesses to shared variables (writes to b, x, y
+// and reads of y, x) whatever the number of threads, only when it finds another thread
+// racing for the lock it scans every thread's flag
+// shared variables are sequentially consistent atomics, which the algorithm needs
+class LamportFastLock : public Lock {
+    // thread id plus 1 of last thread to start entry, 0 is no thread
+    atomic<int> x;
+    // thread id plus 1 of thread which got past x, 0 when lock is free
+    atomic<int> y;
+    // b[i] is true while thread i is trying to enter or in CS
+    atomic<bool>* b;
+    int no_of_threads;
+public:
+    LamportFastLock(int no_of_threads) {
+        this->no_of_threads = no_of_threads;
+        this->b = new atomic<bool>[no_of_threads];
+        for(int i=0;i<no_of_threads;i++)
+            b[i] = false;
+        x = 0;
+        y = 0;
+    }
+
+    void lock(int thread_id) {
+        int i = thread_id + 1;
+        while(true) {
+            b[thread_id] = true;
+            x = i;
+            // another thread is past y, backing off until lock is free
+            if(y != 0) {
+                b[thread_id] = false;
+                while(y != 0) {}
+                continue;
+            }
+            y = i;
+            // fast path, no other thread wrote x since
+            if(x == i)
+                return;
+            // slow path, waiting for every racing thread to leave its entry or CS
+            b[thread_id] = false;
+            for(int j=0;j<no_of_threads;j++)
+                while(b[j]) {}
+            if(y == i)
+                return;
+            // another thread won, waiting until it releases lock
+            while(y != 0) {}
+        }
+    }
+
+    void unlock(int thread_id) {
+        y = 0;
+        b[thread_id] = false;
+    }
+
+    ~LamportFastLock() {
+        delete [] b;
+    }
+};
+
+
+// colors of Black-White Bakery lock
+const int WHITE = 0;
+const int BLACK = 1;
+
+// Taubenfeld's Black-White Bakery lock, a bakery lock whose tickets are bounded by number
+// of threads. A thread takes a ticket of the current color, tickets are compared only
+// within a color, and a thread leaving CS flips the color, hence threads which took the
+// old color are served before any thread of the new color and tickets of a color start
+// again from 1 instead of growing forever
+class BakeryLock : public Lock {
+    // color given to next threads
+    atomic<int> color;
+    atomic<bool>* choosing;
+    atomic<int>* my_color;
+    // ticket of every thread, 0 when not interested, at most no_of_threads
+    atomic<int>* number;
+    int no_of_threads;
+public:
+    BakeryLock(int no_of_threads) {
+        this->no_of_threads = no_of_threads;
+        this->choosing = new atomic<bool>[no_of_threads];
+        this->my_color = new atomic<int>[no_of_threads];
+        this->number = new atomic<int>[no_of_threads];
+        for(int i=0;i<no_of_threads;i++) {
+            choosing[i] = false;
+            my_color[i] = WHITE;
+            number[i] = 0;
+        }
+        color = WHITE;
+    }
+
+    void lock(int i) {
+        // taking ticket one more than every ticket of same color
+        choosing[i] = true;
+        int c = color;
+        my_color[i] = c;
+        int max_number = 0;
+        for(int j=0;j<no_of_threads;j++) {
+            if(my_color[j] == c)
+                max_number = max(max_number, (int)number[j]);
+        }
+        number[i] = max_number + 1;
+        choosing[i] = false;
+
+        for(int j=0;j<no_of_threads;j++) {
+            if(j == i)
+                continue;
+            while(choosing[j]) {}
+            if(my_color[j] == c) {
+                // same color, smaller (ticket, id) goes first
+                while(true) {
+                    int n_j = number[j];
+                    if(n_j == 0 || n_j > number[i] || (n_j == number[i] && j > i) || my_color[j] != c)
+                        break;
+                }
+            }
+            else {
+                // other color goes first while it is the current color
+                while(number[j] != 0 && color == c && my_color[j] != c) {}
+            }
+        }
+    }
+
+    void unlock(int i) {
+        color = my_color[i] == BLACK ? WHITE : BLACK;
+        number[i] = 0;
+    }
+
+    ~BakeryLock() {
+        delete [] choosing;
+        delete [] my_color;
+        delete [] number;
+    }
+};
+
+
+// base class of locks with static dispatch (CRTP), lock and unlock call acquire and release of
+// Derived directly, so a call through Derived or StaticLock<Derived> can be inlined
+template<typename Derived>
+class StaticLock {
+public:
+    void lock(int thread_id) {
+        static_cast<Derived*>(this)->acquire(thread_id);
+    }
+
+    void unlock(int thread_id) {
+        static_cast<Derived*>(this)->release(thread_id);
+    }
+};
+
+
+// Peterson lock for 2 threads with static dispatch, flag and victim are sequentially consistent
+// atomics like the variables of LamportFastLock, the algorithm needs the write to victim ordered
+// before the read of flag[j]
+class StaticPetersonLock : public StaticLock<StaticPetersonLock> {
+    atomic<bool> flag[2];
+    atomic<int> victim;
+public:
+    StaticPetersonLock() {
+        flag[0] = false;
+        flag[1] = false;
+        victim = 0;
+    }
+
+    void acquire(int i) {
+        int j = 1-i;
+        flag[i] = true;
+        victim = i;
+        while(flag[j] && victim == i) {}
+    }
+
+    void release(int i) {
+        flag[i] = false;
+    }
+};
+
+
+// Peterson tree lock for N threads with N-1 binary locks stored inline in a std::array,
+// thread ids are leaf ids N-1 to 2N-2 as with PetersonTreeLock
+template<int N>
+class StaticPetersonTreeLock : public StaticLock<StaticPetersonTreeLock<N>> {
+    array<StaticPetersonLock, N-1> petersonLocks;
+    // largest number of locks on path from a leaf to root
+    static const int MAX_DEPTH = 32;
+public:
+    void acquire(int i) {
+        int lockID = i;
+        // acquiring every lock from leaf till root
+        while(lockID) {
+            petersonLocks[(lockID-1)/2].lock(lockID%2);
+            lockID = (lockID-1)/2;
+        }
+    }
+
+    // releasing locks from root to leaf, path is kept on stack instead of a vector
+    void release(int thread_id) {
+        int lock_ids[MAX_DEPTH + 1];
+        int depth = 0;
+        lock_ids[0] = thread_id;
+        while(lock_ids[depth]) {
+            lock_ids[depth + 1] = (lock_ids[depth]-1)/2;
+            depth++;
+        }
+        for(int i=depth;i>=1;i--)
+            petersonLocks[lock_ids[i]].unlock(lock_ids[i-1]%2);
+    }
+};
+
+
+// Filter lock for N threads with level and victim arrays stored inline in std::arrays,
+// of sequentially consistent atomics as in StaticPetersonLock
+template<int N>
+class StaticFilterLock : public StaticLock<StaticFilterLock<N>> {
+    array<atomic<int>, N> level;
+    array<atomic<int>, N> victim;
+public:
+    StaticFilterLock() {
+        for(int i=0;i<N;i++) {
+            level[i] = 0;
+            victim[i] = 0;
+        }
+    }
+
+    void acquire(int thread_id) {
+        for(int i=1;i<N;i++) {
+            level[thread_id] = i;
+            victim[i] = thread_id;
+            // spin while another thread is at higher or equal level and victim is itself
+            while(true) {
+                bool conflict = false;
+                for(int k=0;k<N;k++) {
+                    if(k == thread_id)
+                        continue;
+                    if(level[k] >= i && victim[i] == thread_id)
+                        conflict = true;
+                }
+                if(!conflict)
+                    break;
+            }
+        }
+    }
+
+    void release(int thread_id) {
+        level[thread_id] = 0;
+    }
+};
+
+
+// type erased adapter which puts a static lock behind the abstract Lock class,
+// for code which mixes locks through Lock* such as a table of locks chosen at run time
+template<typename StaticLockType>
+class LockAdapter : public Lock {
+    StaticLockType lock_impl;
+public:
+    void lock(int thread_id) {
+        lock_impl.lock(thread_id);
+    }
+
+    void unlock(int thread_id) {
+        lock_impl.unlock(thread_id);
+    }
+};
+
 // Critical section entry time taken by each thread
 double cs_enter_time;
 // Critical section exit time taken by each thread
@@ -234,7 +501,9 @@ BE COMMENTED.
 // and lambda_1 is average of delay for simulating CS task which is exponentially distributed
 // and similarly lambda_2 is average of delay for exit section which is also exponentially
 // distributed
-void testCS(int thread_id, int actual_thread_id, int no_of_threads, int no_of_entries, double lambda_1, double lambda_2, Lock* lock_obj) {
+// LockType is Lock for virtual dispatch, or a StaticLock for static dispatch
+template<typename LockType>
+void testCS(int thread_id, int actual_thread_id, int no_of_threads, int no_of_entries, double lambda_1, double lambda_2, LockType* lock_obj) {
     // exponential_distribution for Critical section sleep delay
     exponential_distribution<double> exponential_1((double)1/(double)lambda_1);
     // exponential_distribution for Exit section sleep delay
@@ -291,7 +560,136 @@ void testCS(int thread_id, int actual_thread_id, int no_of_threads, int no_of_en
 }
 
 
-int main() {
+// hides the dynamic type of a lock from the compiler so that calls through it stay virtual
+Lock* opaque(Lock* lock_obj) {
+    asm volatile("" : "+r"(lock_obj));
+    return lock_obj;
+}
+
+// average time in nanoseconds of an uncontended lock and unlock pair by one thread
+template<typename LockType>
+double uncontendedCost(LockType* lock_obj, int thread_id, long pairs) {
+    auto start_time = chrono::high_resolution_clock::now();
+    for(long i=0;i<pairs;i++) {
+        lock_obj->lock(thread_id);
+        // empty critical section the compiler may not merge across iterations
+        asm volatile("" ::: "memory");
+        lock_obj->unlock(thread_id);
+    }
+    auto end_time = chrono::high_resolution_clock::now();
+    return chrono::duration_cast<chrono::nanoseconds>(end_time - start_time).count()/(double)pairs;
+}
+
+// uncontended cost of Filter and Peterson tree locks for N threads as templates behind
+// LockAdapter called through Lock* (virtual) and as templates called directly (static), both
+// run the same atomic implementation so the difference is the cost of dispatch
+template<int N>
+void uncontendedBenchmark() {
+    // filter lock entry reads N levels at each of N-1 levels
+    long filter_pairs = max(20000L, 100000000L/(N*N));
+    long tree_pairs = 10000000;
+
+    StaticFilterLock<N> static_filter_lock;
+    LockAdapter<StaticFilterLock<N>> adapted_filter_lock;
+    StaticPetersonTreeLock<N> static_peterson_tree_lock;
+    LockAdapter<StaticPetersonTreeLock<N>> adapted_peterson_tree_lock;
+
+    cout<<setw(6)<<N<<fixed<<setprecision(1)
+        <<setw(12)<<uncontendedCost(opaque(&adapted_filter_lock), 0, filter_pairs)
+        <<setw(12)<<uncontendedCost(&static_filter_lock, 0, filter_pairs)
+        <<setw(12)<<uncontendedCost(opaque(&adapted_peterson_tree_lock), N-1, tree_pairs)
+        <<setw(12)<<uncontendedCost(&static_peterson_tree_lock, N-1, tree_pairs)<<endl;
+    cout.unsetf(ios::fixed);
+}
+
+// lock and unlock pairs per second by no_of_threads threads sharing lock_obj for duration_ms,
+// thread i uses thread id first_id + i and pauses outside_work iterations between a release
+// and its next request, threads found together inside CS are added to violations
+template<typename LockType>
+double contendedThroughput(LockType* lock_obj, int first_id, int no_of_threads, int outside_work, int duration_ms, long& violations) {
+    atomic<bool> stop(false);
+    atomic<long> acquisitions(0), overlaps(0);
+    atomic<int> threads_in_cs(0);
+    vector<thread> threads;
+    for(int i=0;i<no_of_threads;i++) {
+        threads.push_back(thread([&, i]() {
+            long count = 0;
+            while(!stop.load(memory_order_relaxed)) {
+                lock_obj->lock(first_id + i);
+                if(threads_in_cs.fetch_add(1) != 0)
+                    overlaps++;
+                threads_in_cs.fetch_sub(1);
+                lock_obj->unlock(first_id + i);
+                count++;
+                for(int w=0;w<outside_work;w++)
+                    asm volatile("");
+            }
+            acquisitions += count;
+        }));
+    }
+    auto start_time = chrono::high_resolution_clock::now();
+    this_thread::sleep_for(chrono::milliseconds(duration_ms));
+    stop = true;
+    for(auto& t:threads)
+        t.join();
+    double duration = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - start_time).count()/(double)(pow(10,6));
+    violations += overlaps;
+    return acquisitions/duration;
+}
+
+// throughput of Filter, Peterson tree, Lamport fast and Black-White Bakery locks for 8 threads
+// used by 1 to 8 threads, at low contention threads work outside CS between requests, at high
+// they do not, so the single thread high contention row is the uncontended cost. Static Filter
+// and Peterson tree locks run in the same loop called directly, which also checks their mutual exclusion
+void contentionBenchmark() {
+    const int max_threads = 8;
+    const int duration_ms = 300;
+    const int low_contention_work = 100000;
+    long violations[6] = {0, 0, 0, 0, 0, 0};
+    cout<<"lock and unlock pairs per second"<<endl;
+    cout<<setw(8)<<"threads"<<setw(12)<<"contention"<<setw(12)<<"filter"<<setw(12)<<"tree"
+        <<setw(12)<<"lamport"<<setw(12)<<"bakery"<<setw(12)<<"st filter"<<setw(12)<<"st tree"<<endl;
+    for(int n=1;n<=max_threads;n*=2) {
+        for(int high=0;high<2;high++) {
+            int outside_work = high ? 0 : low_contention_work;
+            FilterLock filter_lock(max_threads);
+            PetersonTreeLock peterson_tree_lock(max_threads);
+            LamportFastLock lamport_fast_lock(max_threads);
+            BakeryLock bakery_lock(max_threads);
+            StaticFilterLock<max_threads> static_filter_lock;
+            StaticPetersonTreeLock<max_threads> static_peterson_tree_lock;
+            cout<<setw(8)<<n<<setw(12)<<(high ? "high" : "low")<<fixed<<setprecision(0)
+                <<setw(12)<<contendedThroughput<Lock>(&filter_lock, 0, n, outside_work, duration_ms, violations[0])
+                <<setw(12)<<contendedThroughput<Lock>(&peterson_tree_lock, max_threads-1, n, outside_work, duration_ms, violations[1])
+                <<setw(12)<<contendedThroughput<Lock>(&lamport_fast_lock, 0, n, outside_work, duration_ms, violations[2])
+                <<setw(12)<<contendedThroughput<Lock>(&bakery_lock, 0, n, outside_work, duration_ms, violations[3])
+                <<setw(12)<<contendedThroughput(&static_filter_lock, 0, n, outside_work, duration_ms, violations[4])
+                <<setw(12)<<contendedThroughput(&static_peterson_tree_lock, max_threads-1, n, outside_work, duration_ms, violations[5])<<endl;
+            cout.unsetf(ios::fixed);
+        }
+    }
+    cout<<"mutual exclusion violations: filter "<<violations[0]<<", tree "<<violations[1]
+        <<", lamport "<<violations[2]<<", bakery "<<violations[3]
+        <<", static filter "<<violations[4]<<", static tree "<<violations[5]<<endl;
+}
+
+int main(int argc, char* argv[]) {
+    // ./out uncontended prints cost of lock and unlock by a single thread with virtual and static dispatch
+    if(argc > 1 && string(argv[1]) == "uncontended") {
+        cout<<"uncontended lock and unlock (ns)"<<endl;
+        cout<<setw(6)<<"N"<<setw(12)<<"filter"<<setw(12)<<"static"<<setw(12)<<"tree"<<setw(12)<<"static"<<endl;
+        uncontendedBenchmark<2>();
+        uncontendedBenchmark<8>();
+        uncontendedBenchmark<64>();
+        return 0;
+    }
+
+    // ./out contention compares throughput of Filter, Peterson tree, Lamport fast, Bakery and static locks
+    if(argc > 1 && string(argv[1]) == "contention") {
+        contentionBenchmark();
+        return 0;
+    }
+
     // seed for default random engine generator
     generator.seed(4);
 
@@ -324,7 +722,7 @@ int main() {
     cs_exit_time = 0;
     output_file<<"Filter Lock Output:\n"<<flush;
     for(int i=0;i<no_of_threads;i++) 
-        filter_lock_threads[i] = thread(testCS, i, i+1, no_of_threads, no_of_entries, lambda_1, lambda_2, &filter_lock);
+        filter_lock_threads[i] = thread(testCS<Lock>, i, i+1, no_of_threads, no_of_entries, lambda_1, lambda_2, &filter_lock);
     for(int i=0;i<no_of_threads;i++)
         filter_lock_threads[i].join();
     // average cs entry time
@@ -340,7 +738,7 @@ int main() {
     cs_exit_time = 0;
     output_file<<"\nPTL Output:\n"<<flush;
     for(int i=0;i<no_of_threads;i++) 
-       peterson_tree_lock_threads[i] = thread(testCS, no_of_threads-1+i, i+1, no_of_threads, no_of_entries, lambda_1, lambda_2, &peterson_tree_lock);
+       peterson_tree_lock_threads[i] = thread(testCS<Lock>, no_of_threads-1+i, i+1, no_of_threads, no_of_entries, lambda_1, lambda_2, &peterson_tree_lock);
     for(int i=0;i<no_of_threads;i++)
         peterson_tree_lock_threads[i].join();
     // average cs entry time
@@ -0,0 +1,189 @@
+#ifndef PRIME_BITMAP_CS17BTECH11001_H
+#define PRIME_BITMAP_CS17BTECH11001_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// odd only prime bitmap file
+// file starts with a header of magic and limit N, followed by 64 bit words where
+// bit i (bit i%64 of word i/64) is set iff odd number 2i+1 is a prime
+// 2 is the only even prime and is answered without the bitmap
+const char PRIME_BITMAP_MAGIC[8] = {'P', 'R', 'I', 'M', 'E', 'B', 'M', '1'};
+
+class PrimeBitmapHeader {
+public:
+    char magic[8];
+    uint64_t limit;
+};
+
+// number of words needed for odd numbers up to limit
+inline uint64_t primeBitmapWords(uint64_t limit) {
+    uint64_t bits = (limit + 1)/2;
+    return (bits + 63)/64;
+}
+
+// size of bitmap file for given limit
+inline uint64_t primeBitmapFileSize(uint64_t limit) {
+    return sizeof(PrimeBitmapHeader) + 8*primeBitmapWords(limit);
+}
+
+// read only view of a prime bitmap file, the file is mapped and never copied,
+// so opening it costs a few system calls regardless of its size
+class PrimeBitmap {
+    const uint64_t* words;
+    uint64_t limit_value;
+    void* mapping;
+    size_t mapping_size;
+
+    // number of set bits in bits [first, last)
+    uint64_t countBits(uint64_t first, uint64_t last) const {
+        if(first >= last)
+            return 0;
+        uint64_t first_word = first/64, last_word = last/64;
+        if(first_word == last_word)
+            return __builtin_popcountll(words[first_word] & (((1ULL << (last % 64)) - 1) & ~((1ULL << (first % 64)) - 1)));
+        uint64_t count = __builtin_popcountll(words[first_word] & ~((1ULL << (first % 64)) - 1));
+        for(uint64_t w=first_word+1;w<last_word;w++)
+            count += __builtin_popcountll(words[w]);
+        if(last % 64)
+            count += __builtin_popcountll(words[last_word] & ((1ULL << (last % 64)) - 1));
+        return count;
+    }
+
+public:
+    PrimeBitmap() {
+        words = NULL;
+        limit_value = 0;
+        mapping = NULL;
+        mapping_size = 0;
+    }
+
+    // maps given bitmap file read only, returns false if it is missing or malformed
+    bool open(std::string path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+            return false;
+        struct stat file_stat;
+        if(fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(PrimeBitmapHeader)) {
+            ::close(fd);
+            return false;
+        }
+        void* data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(data == MAP_FAILED)
+            return false;
+        const PrimeBitmapHeader* header = (const PrimeBitmapHeader*)data;
+        if(memcmp(header->magic, PRIME_BITMAP_MAGIC, 8) != 0
+            || (uint64_t)file_stat.st_size != primeBitmapFileSize(header->limit)) {
+            munmap(data, file_stat.st_size);
+            return false;
+        }
+        mapping = data;
+        mapping_size = file_stat.st_size;
+        limit_value = header->limit;
+        words = (const uint64_t*)((const char*)data + sizeof(PrimeBitmapHeader));
+        return true;
+    }
+
+    void close() {
+        if(mapping != NULL)
+            munmap(mapping, mapping_size);
+        mapping = NULL;
+        words = NULL;
+        limit_value = 0;
+    }
+
+    ~PrimeBitmap() {
+        close();
+    }
+
+    // largest number covered by the bitmap, queries must stay at most limit()
+    uint64_t limit() const {
+        return limit_value;
+    }
+
+    bool isPrime(uint64_t x) const {
+        if(x == 2)
+            return true;
+        if(x < 2 || x % 2 == 0 || x > limit_value)
+            return false;
+        uint64_t bit = x/2;
+        return (words[bit/64] >> (bit % 64)) & 1;
+    }
+
+    // smallest prime greater than x, 0 if there is none up to limit()
+    uint64_t nextPrime(uint64_t x) const {
+        if(x < 2)
+            return limit_value >= 2 ? 2 : 0;
+        // first odd number greater than x
+        uint64_t candidate = x % 2 == 0 ? x + 1 : x + 2;
+        if(candidate > limit_value)
+            return 0;
+        uint64_t bit = candidate/2;
+        uint64_t n_words = primeBitmapWords(limit_value);
+        uint64_t w = bit/64;
+        uint64_t word = words[w] & ~((1ULL << (bit % 64)) - 1);
+        while(word == 0) {
+            w++;
+            if(w >= n_words)
+                return 0;
+            word = words[w];
+        }
+        uint64_t prime = 2*(64*w + __builtin_ctzll(word)) + 1;
+        return prime <= limit_value ? prime : 0;
+    }
+
+    // number of primes p with a <= p <= b, b is clamped to limit()
+    uint64_t countPrimes(uint64_t a, uint64_t b) const {
+        if(b > limit_value)
+            b = limit_value;
+        if(a > b)
+            return 0;
+        uint64_t count = (a <= 2 && 2 <= b) ? 1 : 0;
+        // odd numbers in [a, b] are bits [a/2, (b+1)/2)
+        return count + countBits(a/2, (b + 1)/2);
+    }
+
+    // countPrimes of every range, ranges are answered in one pass over sorted
+    // boundaries, so the bitmap is scanned once instead of once per range
+    std::vector<uint64_t> countPrimes(const std::vector<std::pair<uint64_t, uint64_t>>& ranges) const {
+        std::vector<uint64_t> counts(ranges.size(), 0);
+        // prefix count at each boundary, boundaries are bit positions
+        std::vector<std::pair<uint64_t, size_t>> boundaries;
+        for(size_t i=0;i<ranges.size();i++) {
+            uint64_t a = ranges[i].first, b = std::min(ranges[i].second, limit_value);
+            if(a > b)
+                continue;
+            boundaries.push_back(std::make_pair(a/2, 2*i));
+            boundaries.push_back(std::make_pair((b + 1)/2, 2*i + 1));
+        }
+        std::sort(boundaries.begin(), boundaries.end());
+        uint64_t position = 0, prefix = 0;
+        for(auto& boundary:boundaries) {
+            prefix += countBits(position, boundary.first);
+            position = boundary.first;
+            size_t range = boundary.second/2;
+            if(boundary.second % 2 == 0)
+                counts[range] -= prefix;
+            else
+                counts[range] += prefix;
+        }
+        for(size_t i=0;i<ranges.size();i++) {
+            uint64_t a = ranges[i].first, b = std::min(ranges[i].second, limit_value);
+            if(a <= 2 && 2 <= b)
+                counts[i]++;
+        }
+        return counts;
+    }
+};
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef PRIME_STREAM_CS17BTECH11001_H
+#define PRIME_STREAM_CS17BTECH11001_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+
+// stream of primes in [first, limit] in ascending order
+// worker threads sieve odd only segments ahead of the consumer into a ring of segment buffers,
+// segment s goes into slot s % ring_size, and a worker waits before sieving a segment which is
+// ring_size segments ahead of the consumer, so memory is ring_size segments plus the primes up
+// to square root of limit, whatever limit is (about 80000 base primes for 10^12)
+class PrimeStream {
+    // words of a segment, 32 KB of bitmap fits into L1 cache, covers 2^19 numbers
+    static const uint64_t SEGMENT_WORDS = 4096;
+    static const uint64_t SEGMENT_BITS = 64*SEGMENT_WORDS;
+
+    class Slot {
+    public:
+        std::vector<uint64_t> words;
+        // set by the worker once the segment is sieved, cleared by the consumer
+        bool ready;
+    };
+
+    uint64_t limit_value;
+    // bits of odd numbers, bit i is odd number 2i+1, segments cover bits [first_bit, last_bit)
+    uint64_t first_bit, last_bit, n_segments;
+    std::vector<uint64_t> base_primes;
+    std::vector<Slot> slots;
+    std::vector<std::thread> workers;
+    std::atomic<uint64_t> next_segment;
+
+    // guards ready flags, consumed and stopped
+    std::mutex ring_lock;
+    std::condition_variable slot_free, slot_ready;
+    // number of segments consumer is done with
+    uint64_t consumed;
+    bool stopped;
+
+    // consumer position, a word of current segment with already yielded bits cleared
+    uint64_t segment;
+    uint64_t word_index;
+    uint64_t word;
+    bool segment_held;
+    bool two_pending;
+
+    // odd primes up to limit with a simple sieve of odd numbers
+    static std::vector<uint64_t> oddPrimesUpTo(uint64_t limit) {
+        std::vector<uint64_t> primes;
+        std::vector<bool> composite(limit/2 + 1, false);
+        for(uint64_t i=3;i<=limit;i+=2) {
+            if(composite[i/2])
+                continue;
+            primes.push_back(i);
+            for(uint64_t j=i*i;j<=limit;j+=2*i)
+                composite[j/2] = true;
+        }
+        return primes;
+    }
+
+    // sieves odd numbers of given segment into words, only bits in [first_bit, last_bit) stay set
+    void sieveSegment(uint64_t s, std::vector<uint64_t>& words) {
+        uint64_t low_bit = s*SEGMENT_BITS, high_bit = std::min(low_bit + SEGMENT_BITS, last_bit);
+        std::fill(words.begin(), words.end(), ~0ULL);
+        // odd numbers of segment are 2*low_bit+1 to 2*high_bit-1
+        uint64_t low = 2*low_bit + 1, high = 2*high_bit - 1;
+        for(uint64_t p:base_primes) {
+            if(p*p > high)
+                break;
+            // first odd multiple of p which is at least max(p*p, low)
+            uint64_t multiple = std::max(p*p, (low + p - 1)/p*p);
+            if(multiple % 2 == 0)
+                multiple += p;
+            // consecutive odd multiples are 2p apart, i.e. p bits apart
+            for(uint64_t bit=multiple/2;bit<high_bit;bit+=p)
+                words[(bit - low_bit)/64] &= ~(1ULL << (bit % 64));
+        }
+        // 1 is not a prime, bits outside [first_bit, last_bit) are cleared
+        if(low_bit == 0)
+            words[0] &= ~1ULL;
+        for(uint64_t bit=low_bit;bit<std::max(low_bit, std::min(first_bit, high_bit));bit++)
+            words[(bit - low_bit)/64] &= ~(1ULL << (bit % 64));
+        for(uint64_t bit=high_bit;bit<low_bit + SEGMENT_BITS;bit++)
+            words[(bit - low_bit)/64] &= ~(1ULL << (bit % 64));
+    }
+
+    void work() {
+        while(true) {
+            uint64_t s = next_segment.fetch_add(1);
+            if(s >= n_segments)
+                return;
+            Slot& slot = slots[s % slots.size()];
+            {
+                // backpressure, waiting for consumer to release segment s - ring size
+                std::unique_lock<std::mutex> guard(ring_lock);
+                slot_free.wait(guard, [&]() { return stopped || s < consumed + slots.size(); });
+                if(stopped)
+                    return;
+            }
+            sieveSegment(s, slot.words);
+            std::lock_guard<std::mutex> guard(ring_lock);
+            slot.ready = true;
+            slot_ready.notify_all();
+        }
+    }
+
+    // gives current segment back to the workers
+    void releaseSegment() {
+        std::lock_guard<std::mutex> guard(ring_lock);
+        slots[segment % slots.size()].ready = false;
+        consumed++;
+        segment_held = false;
+        segment++;
+        slot_free.notify_all();
+    }
+
+public:
+    // primes in [first, limit] sieved by n_threads workers into a ring of ring_size segments
+    PrimeStream(uint64_t first, uint64_t limit, int n_threads, int ring_size = 0) : next_segment(0) {
+        limit_value = limit;
+        two_pending = first <= 2 && 2 <= limit;
+        // odd numbers in [first, limit] are bits [first/2, (limit+1)/2)
+        first_bit = first/2;
+        last_bit = std::max(first_bit, (limit + 1)/2);
+        if(limit < first)
+            last_bit = first_bit;
+        uint64_t root = (uint64_t)std::sqrt((double)limit);
+        while((root + 1)*(root + 1) <= limit)
+            root++;
+        while(root*root > limit)
+            root--;
+        base_primes = oddPrimesUpTo(root);
+        // segments are numbered from bit 0 so that they are aligned to words
+        segment = first_bit/SEGMENT_BITS;
+        n_segments = last_bit > first_bit ? (last_bit - 1)/SEGMENT_BITS + 1 : segment;
+        next_segment = segment;
+        consumed = segment;
+        stopped = false;
+        segment_held = false;
+        word_index = 0;
+        word = 0;
+        if(n_threads < 1)
+            n_threads = 1;
+        // two segments per worker keep every worker busy while consumer reads one
+        if(ring_size < 1)
+            ring_size = 2*n_threads;
+        slots.resize(ring_size);
+        for(auto& slot:slots) {
+            slot.words.resize(SEGMENT_WORDS);
+            slot.ready = false;
+        }
+        for(int i=0;i<n_threads;i++)
+            workers.push_back(std::thread(&PrimeStream::work, this));
+    }
+
+    PrimeStream(uint64_t limit, int n_threads) : PrimeStream(0, limit, n_threads) {}
+
+    ~PrimeStream() {
+        {
+            std::lock_guard<std::mutex> guard(ring_lock);
+            stopped = true;
+            slot_free.notify_all();
+        }
+        for(auto& t:workers)
+            t.join();
+    }
+
+    PrimeStream(const PrimeStream&) = delete;
+    PrimeStream& operator=(const PrimeStream&) = delete;
+
+    // stores next prime in prime, returns false once all primes upto limit are yielded
+    bool next(uint64_t& prime) {
+        if(two_pending) {
+            two_pending = false;
+            prime = 2;
+            return true;
+        }
+        while(word == 0) {
+            if(segment_held && ++word_index < SEGMENT_WORDS) {
+                word = slots[segment % slots.size()].words[word_index];
+                continue;
+            }
+            if(segment_held)
+                releaseSegment();
+            if(segment >= n_segments)
+                return false;
+            // waiting for workers to sieve next segment
+            std::unique_lock<std::mutex> guard(ring_lock);
+            Slot& slot = slots[segment % slots.size()];
+            slot_ready.wait(guard, [&]() { return slot.ready; });
+            segment_held = true;
+            word_index = 0;
+            word = slot.words[0];
+        }
+        uint64_t bit = segment*SEGMENT_BITS + 64*word_index + __builtin_ctzll(word);
+        word &= word - 1;
+        prime = 2*bit + 1;
+        return true;
+    }
+
+    // calls callback with every remaining prime in ascending order
+    template<typename Callback>
+    void forEach(Callback callback) {
+        uint64_t prime;
+        while(next(prime))
+            callback(prime);
+    }
+
+    uint64_t limit() const {
+        return limit_value;
+    }
+};
+
+#endif
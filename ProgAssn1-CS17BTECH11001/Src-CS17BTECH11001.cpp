@@ -5,6 +5,18 @@
 #include <mutex>
 #include <ctime>
 #include <math.h>
+#include <atomic>
+#include <condition_variable>
+#include <vector>
+#include <string>
+#include <iomanip>
+#include <cstdio>
+#include <sstream>
+#include <algorithm>
+#include "PrimeBitmap-CS17BTECH11001.h"
+#include "PrimeStream-CS17BTECH11001.h"
+#include <sys/resource.h>
+#include <sys/wait.h>
 using namespace std;
 
 // output files stream
@@ -12,8 +24,6 @@ ofstream primes_DAM_output_file;
 ofstream primes_SAM1_output_file;
 ofstream primes_SAM2_output_file;
 
-// mutex lock for counter
-mutex counter_lock;
 // mutex lock for DAM output file
 mutex DAM_file_lock;
 // mutex lock for SAM1 output file
@@ -21,24 +31,253 @@ mutex SAM1_file_lock;
 // mutex lock for SAM2 output file
 mutex SAM2_file_lock;
 
-// counter class
+// counter interface, thread_id ranges from 0 to number of threads-1
 class Counter {
+public:
+    // returns a value no other call returns and counts it
+    virtual long getAndIncrement(int thread_id) = 0;
+    // initial value plus number of increments so far
+    virtual long get() = 0;
+    virtual ~Counter() {}
+};
+
+// counter guarded by one mutex, every thread is serialized on counter_lock
+class MutexCounter : public Counter {
     long value;
+    // mutex lock for counter
+    mutex counter_lock;
 public:
-    Counter(int val) {
+    MutexCounter(long val) {
         value = val;
     }
-    long getAndIncrement() {
+    long getAndIncrement(int) {
         // critical section 
         counter_lock.lock();
-        int ret_val = value++;
+        long ret_val = value++;
         counter_lock.unlock();
         return ret_val;
     }
+    long get() {
+        lock_guard<mutex> guard(counter_lock);
+        return value;
+    }
+};
+
+// counter incremented with one fetch_add, threads still share its cache line
+class AtomicCounter : public Counter {
+    atomic<long> value;
+public:
+    AtomicCounter(long val) {
+        value.store(val);
+    }
+    long getAndIncrement(int) {
+        return value.fetch_add(1);
+    }
+    long get() {
+        return value.load();
+    }
+};
+
+// software combining tree counter
+// two threads share a leaf, a thread climbing the tree combines its increments with
+// the ones of a thread which got to a node first, and only the thread reaching the root
+// changes the counter, then results are distributed down along the same path
+class CombiningTreeCounter : public Counter {
+    // states of a node
+    enum Status {IDLE, FIRST, SECOND, RESULT, ROOT};
+
+    class Node {
+    public:
+        Status status;
+        // node is locked while its first thread is combining or distributing
+        bool locked;
+        long first_value, second_value;
+        // value of counter at root, value handed down by first thread otherwise
+        long result;
+        Node* parent;
+        mutex node_lock;
+        condition_variable node_changed;
+
+        Node(Node* parent_node, long init) {
+            status = parent_node == NULL ? ROOT : IDLE;
+            locked = false;
+            first_value = second_value = 0;
+            result = init;
+            parent = parent_node;
+        }
+
+        // true if thread is first at this node and has to go on climbing
+        bool precombine() {
+            unique_lock<mutex> guard(node_lock);
+            node_changed.wait(guard, [this]() { return !locked; });
+            switch(status) {
+            case IDLE:
+                status = FIRST;
+                return true;
+            case FIRST:
+                // second thread of node, it will wait for first thread to carry its value
+                locked = true;
+                status = SECOND;
+                return false;
+            default:
+                return false;
+            }
+        }
+
+        // adding value of second thread, if any, to the ones combined so far
+        long combine(long combined) {
+            unique_lock<mutex> guard(node_lock);
+            node_changed.wait(guard, [this]() { return !locked; });
+            locked = true;
+            first_value = combined;
+            if(status == SECOND)
+                return first_value + second_value;
+            return first_value;
+        }
+
+        // applying combined increments at root, or handing them to the first thread
+        // and waiting for the result at the node where second thread stopped
+        long op(long combined) {
+            unique_lock<mutex> guard(node_lock);
+            if(status == ROOT) {
+                long prior = result;
+                result += combined;
+                return prior;
+            }
+            second_value = combined;
+            locked = false;
+            node_changed.notify_all();
+            node_changed.wait(guard, [this]() { return status == RESULT; });
+            locked = false;
+            status = IDLE;
+            node_changed.notify_all();
+            return result;
+        }
+
+        // handing result down to second thread of node, if any
+        void distribute(long prior) {
+            unique_lock<mutex> guard(node_lock);
+            if(status == FIRST) {
+                status = IDLE;
+                locked = false;
+            }
+            else {
+                result = prior + first_value;
+                status = RESULT;
+            }
+            node_changed.notify_all();
+        }
+    };
+
+    // nodes on path from a leaf to root, enough for 2^31 leaves
+    static const int MAX_DEPTH = 32;
+
+    vector<Node*> nodes;
+    // leaf of thread i is leaves[i/2]
+    vector<Node*> leaves;
+
+public:
+    CombiningTreeCounter(long val, int n_threads) {
+        int width = max(2, n_threads);
+        // complete binary tree with width/2 leaves, node i has children 2i+1 and 2i+2
+        int n_leaves = (width + 1)/2;
+        int n_nodes = 2*n_leaves - 1;
+        nodes.push_back(new Node(NULL, val));
+        for(int i=1;i<n_nodes;i++)
+            nodes.push_back(new Node(nodes[(i-1)/2], 0));
+        for(int i=0;i<n_leaves;i++)
+            leaves.push_back(nodes[n_nodes - 1 - i]);
+    }
+
+    long getAndIncrement(int thread_id) {
+        Node* my_leaf = leaves[thread_id/2];
+        Node* node = my_leaf;
+        // precombining phase, climbing while this thread is first at a node
+        while(node->precombine())
+            node = node->parent;
+        Node* stop = node;
+        // combining phase, collecting values of second threads on the way
+        Node* path[MAX_DEPTH];
+        int depth = 0;
+        node = my_leaf;
+        long combined = 1;
+        while(node != stop) {
+            combined = node->combine(combined);
+            path[depth++] = node;
+            node = node->parent;
+        }
+        // operation phase
+        long prior = stop->op(combined);
+        // distribution phase
+        while(depth > 0)
+            path[--depth]->distribute(prior);
+        return prior;
+    }
+
+    long get() {
+        lock_guard<mutex> guard(nodes[0]->node_lock);
+        return nodes[0]->result;
+    }
+
+    ~CombiningTreeCounter() {
+        for(auto node:nodes)
+            delete node;
+    }
+};
+
+// sharded counter, every thread owns a slot on its own cache line and takes blocks of
+// values from a shared counter, so it touches shared memory once per block
+// values are unique but not handed out in increasing order across threads,
+// get() sums the slots without stopping writers and is therefore approximate
+class ShardedCounter : public Counter {
+    // values taken at once by a slot
+    static const long BLOCK_SIZE = 64;
+
+    class Slot {
+    public:
+        // next value of current block and end of it, only touched by owner
+        long next, end;
+        // values handed out by this slot, read by get()
+        atomic<long> count;
+        // padding to keep slots of different threads on different cache lines
+        char padding[64];
+    };
+
+    long initial;
+    atomic<long> next_block;
+    vector<Slot> slots;
+
+public:
+    ShardedCounter(long val, int n_threads) : slots(n_threads) {
+        initial = val;
+        next_block.store(val);
+        for(auto& slot:slots) {
+            slot.next = slot.end = 0;
+            slot.count.store(0);
+        }
+    }
+
+    long getAndIncrement(int thread_id) {
+        Slot& slot = slots[thread_id];
+        if(slot.next == slot.end) {
+            slot.next = next_block.fetch_add(BLOCK_SIZE);
+            slot.end = slot.next + BLOCK_SIZE;
+        }
+        // only owner writes count, hence a relaxed load and store are enough
+        slot.count.store(slot.count.load(memory_order_relaxed) + 1, memory_order_relaxed);
+        return slot.next++;
+    }
+
+    long get() {
+        long sum = initial;
+        for(auto& slot:slots)
+            sum += slot.count.load(memory_order_relaxed);
+        return sum;
+    }
 };
 
 // primality test of number n i.e. check if n is prime or not
-bool checkPrimality(int n) {
+bool checkPrimalityTrialDivision(int n) {
     // if any number i between 2 to square root of n divides
     // n, then its composite
     for(int i=2;i*i<=n;i++) {
@@ -48,65 +287,801 @@ bool checkPrimality(int n) {
     return true;
 }
 
+// number of odd primes below 2^16, enough to test every 32 bit number
+const int SMALL_ODD_PRIME_COUNT = 6541;
+
+// inverse of odd d modulo 2^w where w is number of bits of U,
+// every Newton step x = x*(2 - d*x) doubles number of correct low bits of x = d
+template<typename U>
+constexpr U inverseOf(U d) {
+    U x = d;
+    for(int i=0;i<5;i++)
+        x *= 2 - d*x;
+    return x;
+}
+
+// odd primes below 2^16 generated at compile time with what a multiply only divisibility test
+// of w bit numbers needs: n is divisible by odd p iff n*inverse(p) mod 2^w <= (2^w - 1)/p
+template<typename U>
+class SmallPrimeTable {
+public:
+    uint32_t primes[SMALL_ODD_PRIME_COUNT];
+    U inverses[SMALL_ODD_PRIME_COUNT];
+    U limits[SMALL_ODD_PRIME_COUNT];
+
+    constexpr SmallPrimeTable() : primes(), inverses(), limits() {
+        bool composite[1 << 16] = {};
+        int count = 0;
+        for(uint32_t i=3;i<(1 << 16);i+=2) {
+            if(composite[i])
+                continue;
+            primes[count] = i;
+            inverses[count] = inverseOf<U>(i);
+            limits[count] = (U)~(U)0/i;
+            count++;
+            for(uint32_t j=i*i;j<(1 << 16);j+=2*i)
+                composite[j] = true;
+        }
+    }
+};
+
+constexpr SmallPrimeTable<uint32_t> small_primes_32;
+constexpr SmallPrimeTable<uint64_t> small_primes_64;
+
+// results of testing a number against small primes
+const int SMALL_PRIMES_COMPOSITE = 0, SMALL_PRIMES_PRIME = 1, SMALL_PRIMES_UNDECIDED = 2;
+
+// divides odd n > 1 by the odd primes of table upto square root of n
+template<typename U>
+inline int testSmallPrimes(U n, const SmallPrimeTable<U>& table) {
+    for(int i=0;i<SMALL_ODD_PRIME_COUNT;i++) {
+        U p = table.primes[i];
+        if(p*p > n)
+            return SMALL_PRIMES_PRIME;
+        if(n*table.inverses[i] <= table.limits[i])
+            return SMALL_PRIMES_COMPOSITE;
+    }
+    return SMALL_PRIMES_UNDECIDED;
+}
+
+// primality test dividing only by primes, answers are those of checkPrimalityTrialDivision,
+// including 0 and 1 which it reports as primes
+template<typename U>
+bool checkPrimalitySmallPrimes(U n);
+
+// every 32 bit number has a prime factor below 2^16 unless it is a prime
+template<>
+bool checkPrimalitySmallPrimes<uint32_t>(uint32_t n) {
+    if(n < 2 || n == 2)
+        return true;
+    if(n % 2 == 0)
+        return false;
+    return testSmallPrimes(n, small_primes_32) != SMALL_PRIMES_COMPOSITE;
+}
+
+// numbers above 2^32 use 64 bit multiplies and are divided by odd numbers beyond the table
+template<>
+bool checkPrimalitySmallPrimes<uint64_t>(uint64_t n) {
+    if(n <= UINT32_MAX)
+        return checkPrimalitySmallPrimes<uint32_t>((uint32_t)n);
+    if(n % 2 == 0)
+        return false;
+    int result = testSmallPrimes(n, small_primes_64);
+    if(result != SMALL_PRIMES_UNDECIDED)
+        return result == SMALL_PRIMES_PRIME;
+    for(uint64_t i=(1 << 16) + 1;i*i<=n;i+=2) {
+        if(n%i == 0)
+            return false;
+    }
+    return true;
+}
+
+// kernel used by checkPrimality, small prime kernel unless trial division is asked for
+bool use_trial_division = false;
+
+bool checkPrimality(long n) {
+    if(use_trial_division)
+        return checkPrimalityTrialDivision(n);
+    return checkPrimalitySmallPrimes<uint64_t>(n);
+}
+
 // dynamic allocation method where each thread gets a prime number to test dynamically
-void DAM(Counter* counter, int n, int threadId) {
+// numbers are taken from counter until they exceed n, primes are appended to output
+void DAM(Counter* counter, long n, int threadId, ostream& output, mutex& output_lock) {
     while(true) {
         // calling counter getAndIncrement to obtain number to test
-        int counter_val = counter->getAndIncrement();
+        long counter_val = counter->getAndIncrement(threadId - 1);
         // returning if number is greater than n
         if(counter_val > n)
             return;
         if(checkPrimality(counter_val)) {
             // critical section
             // append number to output file
-            DAM_file_lock.lock();
-            primes_DAM_output_file<<counter_val<<" ";
-            DAM_file_lock.unlock();
+            output_lock.lock();
+            output<<counter_val<<" ";
+            output_lock.unlock();
+        }
+    }
+}
+
+// DAM taking chunks of numbers, counter value k stands for numbers first + k*chunk upto
+// first + k*chunk + chunk - 1, primes of a chunk are appended to output at once
+void DAMChunked(Counter* counter, long first, long n, long chunk, int threadId, ostream& output, mutex& output_lock) {
+    while(true) {
+        long chunk_first = first + counter->getAndIncrement(threadId - 1)*chunk;
+        if(chunk_first > n)
+            return;
+        string chunk_primes;
+        for(long x=chunk_first;x<=min(n, chunk_first + chunk - 1);x++) {
+            if(checkPrimality(x)) {
+                chunk_primes += to_string(x);
+                chunk_primes += ' ';
+            }
+        }
+        if(!chunk_primes.empty()) {
+            output_lock.lock();
+            output<<chunk_primes;
+            output_lock.unlock();
         }
     }
 }
 
 // static allocation method1 where each thread gets prime number to test in gap of threads count
-void SAM1(int n, int noOfThreads, int threadId) {
-    int count = 0;
+// numbers tested are first, first+1, ... upto n
+void SAM1(long first, long n, int noOfThreads, int threadId, ostream& output, mutex& output_lock) {
+    long count = 0;
     while(true) {
         // next number to test is in gap of noOfThreads
-        int next_number = count*noOfThreads + threadId;
+        long next_number = first + count*noOfThreads + threadId - 1;
         // breaking if number is greater than n
         if(next_number > n)
             break;
         if(checkPrimality(next_number)) {
             // critical section
             // append number to output file
-            SAM1_file_lock.lock();
-            primes_SAM1_output_file<<next_number<<" ";
-            SAM1_file_lock.unlock();
+            output_lock.lock();
+            output<<next_number<<" ";
+            output_lock.unlock();
         }
         count++; 
     }
 }
 
 // static allocation method2 where threads are given only odd numbers to test in gap of threads count
-void SAM2(int n, int noOfThreads, int threadId) {
-    int count = 0;
+// numbers tested are odd numbers from first upto n
+void SAM2(long first, long n, int noOfThreads, int threadId, ostream& output, mutex& output_lock) {
+    long count = 0;
+    // first odd number of the range
+    long first_odd = first | 1;
     while(true) {
         // next number to test is in gap of 2*noOfThreads since even numbers are skipped
-        int next_number = 2*count*noOfThreads + (2*threadId-1);
+        long next_number = first_odd + 2*count*noOfThreads + 2*(threadId-1);
         // breaking if number is greater than n
         if(next_number > n)
             break;
         if(checkPrimality(next_number)) {
             // critical section
             // append number to output file
-            SAM2_file_lock.lock();
-            primes_SAM2_output_file<<next_number<<" ";
-            SAM2_file_lock.unlock();
+            output_lock.lock();
+            output<<next_number<<" ";
+            output_lock.unlock();
         }
         count++; 
     }
 }
 
-int main() {
+// counter of given kind for given number of threads
+Counter* makeCounter(string kind, long val, int n_threads) {
+    if(kind == "mutex")
+        return new MutexCounter(val);
+    if(kind == "tree")
+        return new CombiningTreeCounter(val, n_threads);
+    if(kind == "sharded")
+        return new ShardedCounter(val, n_threads);
+    return new AtomicCounter(val);
+}
+
+// microbenchmark of counters, for every thread count threads increment for a fixed
+// time, then cost of reading the counter with all its threads' state is measured
+void counterBenchmark() {
+    string kinds[] = {"mutex", "atomic", "tree", "sharded"};
+    const int duration_ms = 200;
+    cout<<left<<setw(10)<<"counter"<<right<<setw(10)<<"threads"<<setw(18)<<"increments/s"<<setw(14)<<"read (ns)"<<endl;
+    for(string kind:kinds) {
+        for(int n_threads=1;n_threads<=128;n_threads*=2) {
+            Counter* counter = makeCounter(kind, 0, n_threads);
+            atomic<bool> stop(false);
+            vector<thread> threads;
+            for(int i=0;i<n_threads;i++) {
+                threads.push_back(thread([&stop, counter, i]() {
+                    while(!stop.load(memory_order_relaxed))
+                        counter->getAndIncrement(i);
+                }));
+            }
+            auto start_time = chrono::high_resolution_clock::now();
+            this_thread::sleep_for(chrono::milliseconds(duration_ms));
+            stop = true;
+            for(auto& t:threads)
+                t.join();
+            double duration = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - start_time).count()/(double)(pow(10,6));
+            long increments = counter->get();
+            // reading counter, sharded counter has to visit every slot
+            const long reads = 100000;
+            volatile long sink = 0;
+            auto read_start_time = chrono::high_resolution_clock::now();
+            for(long r=0;r<reads;r++)
+                sink = counter->get();
+            double read_duration = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - read_start_time).count();
+            cout<<left<<setw(10)<<kind<<right<<setw(10)<<n_threads<<fixed<<setprecision(0)<<setw(18)<<increments/duration
+                <<setprecision(1)<<setw(14)<<read_duration/reads<<endl;
+            cout.unsetf(ios::fixed);
+            (void)sink;
+            delete counter;
+        }
+    }
+}
+
+// name of prime bitmap file written by bitmap mode
+const string PRIME_BITMAP_FILE = "Primes.bitmap";
+
+// primes up to limit found with a simple sieve, used to sieve segments of the bitmap
+vector<uint64_t> basePrimes(uint64_t limit) {
+    vector<bool> composite(limit + 1, false);
+    vector<uint64_t> primes;
+    for(uint64_t i=2;i<=limit;i++) {
+        if(composite[i])
+            continue;
+        primes.push_back(i);
+        for(uint64_t j=i*i;j<=limit;j+=i)
+            composite[j] = true;
+    }
+    return primes;
+}
+
+// builds odd only prime bitmap of numbers up to N into given file
+// threads take segments of the bitmap dynamically as in DAM and sieve them with the odd
+// primes up to square root of N, segments are whole words, hence threads never share a word
+// bitmap is written into a temporary file mapped shared and renamed once it is complete
+bool buildPrimeBitmap(uint64_t N, int noOfThreads, string path) {
+    // words of a segment, 32 KB of bitmap fits into L1 cache
+    const uint64_t SEGMENT_WORDS = 4096;
+    uint64_t n_bits = (N + 1)/2;
+    uint64_t n_words = primeBitmapWords(N);
+    uint64_t n_segments = (n_words + SEGMENT_WORDS - 1)/SEGMENT_WORDS;
+    string temp_path = path + ".tmp";
+    int fd = open(temp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+        return false;
+    uint64_t file_size = primeBitmapFileSize(N);
+    if(ftruncate(fd, file_size) != 0) {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+        return false;
+    PrimeBitmapHeader* header = (PrimeBitmapHeader*)data;
+    memcpy(header->magic, PRIME_BITMAP_MAGIC, 8);
+    header->limit = N;
+    uint64_t* words = (uint64_t*)((char*)data + sizeof(PrimeBitmapHeader));
+
+    uint64_t root = (uint64_t)sqrt((double)N);
+    while((root + 1)*(root + 1) <= N)
+        root++;
+    vector<uint64_t> primes = basePrimes(root);
+    atomic<uint64_t> next_segment(0);
+
+    auto sieveSegments = [&]() {
+        while(true) {
+            uint64_t segment = next_segment.fetch_add(1);
+            if(segment >= n_segments)
+                return;
+            uint64_t first_word = segment*SEGMENT_WORDS;
+            uint64_t last_word = min(first_word + SEGMENT_WORDS, n_words);
+            uint64_t first_bit = first_word*64, last_bit = min(last_word*64, n_bits);
+            fill(words + first_word, words + last_word, ~0ULL);
+            // odd numbers of segment are 2*first_bit+1 to 2*last_bit-1
+            uint64_t low = 2*first_bit + 1, high = 2*last_bit - 1;
+            for(uint64_t p:primes) {
+                if(p == 2)
+                    continue;
+                if(p*p > high)
+                    break;
+                // first odd multiple of p which is at least max(p*p, low)
+                uint64_t multiple = max(p*p, (low + p - 1)/p*p);
+                if(multiple % 2 == 0)
+                    multiple += p;
+                // consecutive odd multiples are 2p apart, i.e. p bits apart
+                for(uint64_t bit=multiple/2;bit<last_bit;bit+=p)
+                    words[bit/64] &= ~(1ULL << (bit % 64));
+            }
+            // 1 is not a prime and bits beyond N are cleared
+            if(first_bit == 0)
+                words[0] &= ~1ULL;
+            if(last_word*64 > n_bits && n_bits % 64)
+                words[last_word - 1] &= (1ULL << (n_bits % 64)) - 1;
+        }
+    };
+    vector<thread> threads;
+    for(int i=0;i<noOfThreads;i++)
+        threads.push_back(thread(sieveSegments));
+    for(auto& t:threads)
+        t.join();
+
+    bool synced = msync(data, file_size, MS_SYNC) == 0;
+    munmap(data, file_size);
+    return synced && rename(temp_path.c_str(), path.c_str()) == 0;
+}
+
+// answers queries read from standard input using the mapped bitmap, one per line:
+// "isPrime x", "nextPrime x", "count a b", or "batch k" followed by k pairs a b
+void answerQueries(const PrimeBitmap& bitmap) {
+    string query;
+    while(cin>>query) {
+        if(query == "isPrime") {
+            uint64_t x;
+            cin>>x;
+            cout<<(bitmap.isPrime(x) ? "true" : "false")<<endl;
+        }
+        else if(query == "nextPrime") {
+            uint64_t x;
+            cin>>x;
+            cout<<bitmap.nextPrime(x)<<endl;
+        }
+        else if(query == "count") {
+            uint64_t a, b;
+            cin>>a>>b;
+            cout<<bitmap.countPrimes(a, b)<<endl;
+        }
+        else if(query == "batch") {
+            size_t k;
+            cin>>k;
+            vector<pair<uint64_t, uint64_t>> ranges(k);
+            for(size_t i=0;i<k;i++)
+                cin>>ranges[i].first>>ranges[i].second;
+            for(uint64_t count:bitmap.countPrimes(ranges))
+                cout<<count<<" ";
+            cout<<endl;
+        }
+        else
+            cout<<"unknown query "<<query<<endl;
+    }
+}
+
+// numbers tested by one chunk of a resumable run, a checkpoint is written after every chunk
+const long CHECKPOINT_CHUNK = 1 << 20;
+
+// runs given method (DAM, SAM1 or SAM2) with noOfThreads threads on numbers first to last,
+// DAM takes chunk numbers at a time when chunk is more than 1
+void runMethod(string method, long first, long last, int noOfThreads, string counter_kind, ostream& output, mutex& output_lock, long chunk = 1) {
+    vector<thread> threads;
+    Counter* counter = NULL;
+    if(method == "DAM")
+        counter = makeCounter(counter_kind, chunk > 1 ? 0 : first, noOfThreads);
+    for(int i=1;i<=noOfThreads;i++) {
+        if(method == "DAM" && chunk > 1)
+            threads.push_back(thread(DAMChunked, counter, first, last, chunk, i, ref(output), ref(output_lock)));
+        else if(method == "DAM")
+            threads.push_back(thread(DAM, counter, last, i, ref(output), ref(output_lock)));
+        else if(method == "SAM1")
+            threads.push_back(thread(SAM1, first, last, noOfThreads, i, ref(output), ref(output_lock)));
+        else
+            threads.push_back(thread(SAM2, first, last, noOfThreads, i, ref(output), ref(output_lock)));
+    }
+    for(auto& t:threads)
+        t.join();
+    delete counter;
+}
+
+// resumable run of given method for numbers upto N
+// Checkpoint-<method>.txt is an append only log with a line "first last offset seconds" for every
+// completed range, written after the primes of the range are appended to Primes-<method>.txt
+// and flushed, offset being size of primes file at that point and seconds the time the range took. On start the primes file is cut
+// back to the last logged offset, hence primes of a range killed midway are dropped, and only
+// ranges missing from the log are computed, so moving to a larger N tests only the new numbers.
+// A log covering numbers above N is refused rather than leaving those primes in the output.
+// Time saved against a full run is the logged time of reused ranges, ranges logged without
+// time (older logs) are charged at the rate measured in this run
+// returns time taken in seconds
+double resumeMethod(string method, long N, int noOfThreads, string counter_kind) {
+    string primes_path = "Primes-" + method + ".txt";
+    string checkpoint_path = "Checkpoint-" + method + ".txt";
+
+    // reading completed ranges from checkpoint log, a torn last line is ignored
+    vector<pair<long, long>> completed;
+    // end offset and time in seconds logged for every completed range, in log order,
+    // time is negative if it was not logged
+    vector<long> end_offsets;
+    vector<double> range_times;
+    long offset = 0;
+    ifstream checkpoint_input(checkpoint_path);
+    string line;
+    while(getline(checkpoint_input, line)) {
+        long first, last, end_offset;
+        double range_time = -1;
+        if(sscanf(line.c_str(), "%ld %ld %ld %lf", &first, &last, &end_offset, &range_time) < 3)
+            break;
+        completed.push_back(make_pair(first, last));
+        end_offsets.push_back(end_offset);
+        range_times.push_back(range_time);
+        offset = end_offset;
+    }
+    checkpoint_input.close();
+
+    // primes file shorter than the log means it was replaced, starting over
+    struct stat primes_stat;
+    if(stat(primes_path.c_str(), &primes_stat) != 0 || primes_stat.st_size < offset) {
+        completed.clear();
+        end_offsets.clear();
+        range_times.clear();
+        offset = 0;
+    }
+    // primes of a range above N are spread through the file, so a smaller N can not be resumed
+    for(auto& range:completed)
+        if(range.second > N) {
+            cerr<<checkpoint_path<<" covers numbers upto "<<range.second<<", more than n = "<<N<<", delete it to start over"<<endl;
+            exit(1);
+        }
+    // dropping primes written after last checkpoint
+    int fd = open(primes_path.c_str(), O_WRONLY | O_CREAT, 0644);
+    if(fd < 0 || ftruncate(fd, offset) != 0) {
+        cerr<<"Could not open "<<primes_path<<endl;
+        exit(1);
+    }
+    close(fd);
+    // rewriting log without a torn line into a temporary file which replaces the log only once
+    // it is on disk, so a crash leaves either the old or the new log
+    stringstream log;
+    for(size_t i=0;i<completed.size();i++) {
+        log<<completed[i].first<<" "<<completed[i].second<<" "<<end_offsets[i];
+        if(range_times[i] >= 0)
+            log<<" "<<range_times[i];
+        log<<"\n";
+    }
+    string log_text = log.str(), temporary_path = checkpoint_path + ".tmp";
+    fd = open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0 || write(fd, log_text.data(), log_text.size()) != (ssize_t)log_text.size() || fsync(fd) != 0
+       || close(fd) != 0 || rename(temporary_path.c_str(), checkpoint_path.c_str()) != 0) {
+        cerr<<"Could not write "<<checkpoint_path<<endl;
+        exit(1);
+    }
+    ofstream checkpoint(checkpoint_path, ios::app);
+
+    // ranges of [1, N] not in the log, split into chunks
+    vector<pair<pair<long, long>, double>> timed_ranges;
+    for(size_t i=0;i<completed.size();i++)
+        timed_ranges.push_back(make_pair(completed[i], range_times[i]));
+    sort(timed_ranges.begin(), timed_ranges.end());
+    vector<pair<long, long>> missing;
+    long next = 1, reused = 0, reused_untimed = 0;
+    // logged time of reused numbers
+    double saved = 0;
+    for(auto& timed_range:timed_ranges) {
+        pair<long, long>& range = timed_range.first;
+        if(range.first > N)
+            break;
+        if(range.second < next)
+            continue;
+        for(long first=next;first<range.first;first+=CHECKPOINT_CHUNK)
+            missing.push_back(make_pair(first, min(range.first - 1, first + CHECKPOINT_CHUNK - 1)));
+        long count = min(range.second, N) - max(range.first, next) + 1;
+        reused += count;
+        if(timed_range.second >= 0)
+            saved += timed_range.second*count/(range.second - range.first + 1);
+        else
+            reused_untimed += count;
+        next = max(next, range.second + 1);
+    }
+    for(long first=next;first<=N;first+=CHECKPOINT_CHUNK)
+        missing.push_back(make_pair(first, min(N, first + CHECKPOINT_CHUNK - 1)));
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    ofstream primes_output(primes_path, ios::app);
+    for(auto& range:missing) {
+        // primes of a chunk are buffered so the file only ever grows by whole chunks
+        stringstream chunk_output;
+        mutex chunk_lock;
+        auto chunk_start_time = std::chrono::high_resolution_clock::now();
+        runMethod(method, range.first, range.second, noOfThreads, counter_kind, chunk_output, chunk_lock);
+        double chunk_time = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - chunk_start_time ).count()/(double)(pow(10,6));
+        string chunk = chunk_output.str();
+        primes_output<<chunk;
+        primes_output.flush();
+        offset += chunk.size();
+        checkpoint<<range.first<<" "<<range.second<<" "<<offset<<" "<<chunk_time<<endl;
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    double duration = std::chrono::duration_cast<std::chrono::microseconds>( end_time - start_time ).count()/(double)(pow(10,6));
+    // reused numbers without logged time are charged at the rate of this run, if it tested any
+    if(reused_untimed > 0 && N > reused)
+        saved += duration*reused_untimed/(N - reused);
+    cout<<method<<": reused "<<reused<<" numbers from checkpoint, tested "<<N - reused<<" numbers in "<<duration<<" s"
+        <<", saved about "<<saved<<" s against a full run of "<<duration + saved<<" s"
+        <<(reused_untimed > 0 && N == reused ? " (ranges logged without time not counted)" : "")<<endl;
+    return duration;
+}
+
+// runs DAM, SAM1 and SAM2 upto n with both primality kernels and prints their times, kernels are
+// first checked to agree on every number upto 10^6, and with plain 64 bit division on 10^4 numbers around 2^32
+void kernelBenchmark(long n, int noOfThreads, string counter_kind) {
+    long disagreements = 0;
+    for(long x=0;x<=1000000;x++)
+        disagreements += checkPrimalityTrialDivision(x) != checkPrimalitySmallPrimes<uint64_t>(x);
+    for(uint64_t x=(1ULL << 32) - 5000;x<(1ULL << 32) + 5000;x++) {
+        bool prime = x % 2 != 0;
+        for(uint64_t i=3;prime && i*i<=x;i+=2)
+            prime = x % i != 0;
+        disagreements += prime != checkPrimalitySmallPrimes<uint64_t>(x);
+    }
+    cout<<"kernels disagree on "<<disagreements<<" numbers"<<endl;
+    string methods[] = {"DAM", "SAM1", "SAM2"};
+    cout<<left<<setw(10)<<"method"<<right<<setw(12)<<"trial (s)"<<setw(16)<<"primes (s)"<<setw(10)<<"speedup"<<endl;
+    for(string method:methods) {
+        double times[2];
+        for(int kernel=0;kernel<2;kernel++) {
+            use_trial_division = kernel == 0;
+            stringstream output;
+            mutex output_lock;
+            auto start_time = std::chrono::high_resolution_clock::now();
+            runMethod(method, 1, n, noOfThreads, counter_kind, output, output_lock);
+            auto end_time = std::chrono::high_resolution_clock::now();
+            times[kernel] = std::chrono::duration_cast<std::chrono::microseconds>( end_time - start_time ).count()/(double)(pow(10,6));
+        }
+        cout<<left<<setw(10)<<method<<right<<fixed<<setprecision(3)<<setw(12)<<times[0]<<setw(16)<<times[1]
+            <<setprecision(2)<<setw(10)<<times[0]/times[1]<<endl;
+        cout.unsetf(ios::fixed);
+    }
+    use_trial_division = false;
+}
+
+// file caching configuration picked by autotune, one line "host cpus method threads chunk" per host
+const string AUTOTUNE_CACHE_FILE = "Autotune.txt";
+
+// configuration of a prime run and numbers per second it reached in calibration
+class TuneConfig {
+public:
+    string method;
+    int threads;
+    long chunk;
+    double rate;
+};
+
+// number of physical cores, logical cpus sharing a core list the same thread siblings
+int physicalCores(int logical_cpus) {
+    vector<string> cores;
+    for(int cpu=0;cpu<logical_cpus;cpu++) {
+        ifstream siblings("/sys/devices/system/cpu/cpu" + to_string(cpu) + "/topology/thread_siblings_list");
+        string list;
+        if(!(siblings>>list))
+            return logical_cpus;
+        if(find(cores.begin(), cores.end(), list) == cores.end())
+            cores.push_back(list);
+    }
+    return max(1, (int)cores.size());
+}
+
+// numbers per second of given configuration on numbers first to last, best of two runs
+double calibrate(TuneConfig config, long first, long last, string counter_kind) {
+    double best = 0;
+    for(int run=0;run<2;run++) {
+        stringstream output;
+        mutex output_lock;
+        auto start_time = std::chrono::high_resolution_clock::now();
+        runMethod(config.method, first, last, config.threads, counter_kind, output, output_lock, config.chunk);
+        auto end_time = std::chrono::high_resolution_clock::now();
+        double duration = std::chrono::duration_cast<std::chrono::microseconds>( end_time - start_time ).count()/(double)(pow(10,6));
+        best = max(best, (last - first + 1)/max(duration, 1e-6));
+    }
+    return best;
+}
+
+// picks method, thread count and DAM chunk size for numbers upto N by timing every candidate on
+// a slice of numbers from N/2, testing cost grows with the numbers so the slice is taken from
+// the middle of the range rather than its start, prints what it measured and why it picked
+TuneConfig autotune(long N, string counter_kind) {
+    int logical_cpus = max(1, (int)thread::hardware_concurrency());
+    int cores = physicalCores(logical_cpus);
+    cout<<"host has "<<cores<<" cores and "<<logical_cpus<<" logical cpus"<<endl;
+    vector<int> thread_counts = {1, cores, logical_cpus, 2*logical_cpus};
+    sort(thread_counts.begin(), thread_counts.end());
+    thread_counts.erase(unique(thread_counts.begin(), thread_counts.end()), thread_counts.end());
+
+    // slice is grown until one thread needs at least 20 ms for it
+    long first = max(1L, N/2), last = first;
+    for(long size=1 << 12;;size*=2) {
+        last = min(N, first + size - 1);
+        TuneConfig probe = {"SAM1", 1, 1, 0};
+        if(last == N || (last - first + 1)/calibrate(probe, first, last, counter_kind) >= 0.02)
+            break;
+    }
+    cout<<"calibrating on numbers "<<first<<" to "<<last<<endl;
+
+    vector<TuneConfig> configs;
+    for(string method:{"DAM", "SAM1", "SAM2"}) {
+        for(int threads:thread_counts) {
+            // only DAM has a granularity, SAM methods interleave single numbers
+            for(long chunk:{1L, 64L, 4096L}) {
+                if(method != "DAM" && chunk > 1)
+                    break;
+                TuneConfig config = {method, threads, chunk, 0};
+                config.rate = calibrate(config, first, last, counter_kind);
+                configs.push_back(config);
+            }
+        }
+    }
+    sort(configs.begin(), configs.end(), [](const TuneConfig& a, const TuneConfig& b) { return a.rate > b.rate; });
+    cout<<left<<setw(10)<<"method"<<right<<setw(10)<<"threads"<<setw(10)<<"chunk"<<setw(18)<<"numbers/s"<<endl;
+    for(auto& config:configs)
+        cout<<left<<setw(10)<<config.method<<right<<setw(10)<<config.threads<<setw(10)<<config.chunk
+            <<fixed<<setprecision(0)<<setw(18)<<config.rate<<endl;
+    cout.unsetf(ios::fixed);
+
+    // explaining the pick against best configuration of every other choice
+    TuneConfig best = configs[0];
+    cout<<"picked "<<best.method<<" with "<<best.threads<<" threads"<<(best.method == "DAM" ? " and chunk " + to_string(best.chunk) : "")<<endl;
+    for(auto& config:configs) {
+        if(config.method != best.method) {
+            cout<<"  "<<setprecision(3)<<best.rate/config.rate<<"x the best "<<config.method<<" ("<<config.threads<<" threads)"<<endl;
+            break;
+        }
+    }
+    for(auto& config:configs) {
+        if(config.threads != best.threads) {
+            cout<<"  "<<setprecision(3)<<best.rate/config.rate<<"x the best run with "<<config.threads<<" threads"<<endl;
+            break;
+        }
+    }
+    if(best.threads > cores)
+        cout<<"  uses hyperthreads, "<<best.threads<<" threads on "<<cores<<" cores"<<endl;
+    else
+        cout<<"  one thread per core at most, "<<best.threads<<" threads on "<<cores<<" cores"<<endl;
+    return best;
+}
+
+// shared state of a multi process run, placed at the start of a shared memfd mapping
+// and followed by the odd only bitmap words of PrimeBitmap
+class SharedPrimeRegion {
+public:
+    // next block to test with dynamic allocation
+    atomic<uint64_t> next_block;
+    // 2 is not in the odd only bitmap, set if it was tested and found prime
+    atomic<int> two_is_prime;
+};
+
+// words of bitmap a process tests at a time, blocks are whole words so processes never share a word
+const uint64_t PROCESS_BLOCK_WORDS = 16;
+
+// tests numbers of given block with checkPrimality and stores their bits
+// DAM and SAM1 test even numbers too as the threaded methods do, SAM2 only odd numbers
+void testBlock(string method, uint64_t block, long n, SharedPrimeRegion* region, uint64_t* words, uint64_t n_words) {
+    uint64_t first_word = block*PROCESS_BLOCK_WORDS, last_word = min(first_word + PROCESS_BLOCK_WORDS, n_words);
+    bool test_evens = method != "SAM2";
+    for(uint64_t w=first_word;w<last_word;w++) {
+        uint64_t bits = 0;
+        for(uint64_t b=0;b<64;b++) {
+            long odd_number = 2*(64*w + b) + 1;
+            if(odd_number > n)
+                break;
+            if(checkPrimality(odd_number))
+                bits |= 1ULL << b;
+            if(test_evens && odd_number + 1 <= n && checkPrimality(odd_number + 1))
+                region->two_is_prime = 1;
+        }
+        words[w] = bits;
+    }
+}
+
+// body of a worker process, takes blocks from the shared counter as in DAM,
+// or blocks process_id, process_id + n_processes, ... as in SAM1 and SAM2
+void processWorker(string method, int process_id, int n_processes, long n, SharedPrimeRegion* region, uint64_t* words) {
+    uint64_t n_words = primeBitmapWords(n);
+    uint64_t n_blocks = (n_words + PROCESS_BLOCK_WORDS - 1)/PROCESS_BLOCK_WORDS;
+    if(method == "DAM") {
+        while(true) {
+            uint64_t block = region->next_block.fetch_add(1);
+            if(block >= n_blocks)
+                return;
+            testBlock(method, block, n, region, words, n_words);
+        }
+    }
+    for(uint64_t block=process_id;block<n_blocks;block+=n_processes)
+        testBlock(method, block, n, region, words, n_words);
+}
+
+// runs given method with n_processes forked processes writing into a shared memfd bitmap,
+// then reduces the bitmap into Primes-<method>.txt in ascending order
+// returns total time in seconds, time spent by the reducer is stored in reduce_time
+double runProcesses(string method, long n, int n_processes, double& reduce_time) {
+    uint64_t n_words = primeBitmapWords(n);
+    size_t size = sizeof(SharedPrimeRegion) + 8*n_words;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    int fd = memfd_create("primes", 0);
+    if(fd < 0 || ftruncate(fd, size) != 0) {
+        cerr<<"Could not create shared bitmap"<<endl;
+        exit(1);
+    }
+    void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        cerr<<"Could not map shared bitmap"<<endl;
+        exit(1);
+    }
+    SharedPrimeRegion* region = new(data) SharedPrimeRegion();
+    region->next_block = 0;
+    region->two_is_prime = 0;
+    uint64_t* words = (uint64_t*)((char*)data + sizeof(SharedPrimeRegion));
+
+    vector<pid_t> workers;
+    for(int i=0;i<n_processes;i++) {
+        pid_t pid = fork();
+        if(pid == 0) {
+            processWorker(method, i, n_processes, n, region, words);
+            _exit(0);
+        }
+        if(pid < 0) {
+            cerr<<"Could not fork worker "<<i<<endl;
+            exit(1);
+        }
+        workers.push_back(pid);
+    }
+    for(pid_t pid:workers) {
+        int status;
+        if(waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            cerr<<"Worker "<<pid<<" failed"<<endl;
+            exit(1);
+        }
+    }
+
+    // reducer, 1 passes checkPrimality so it is written like the threaded methods write it
+    auto reduce_start_time = std::chrono::high_resolution_clock::now();
+    ofstream output("Primes-" + method + ".txt");
+    string buffer;
+    for(uint64_t w=0;w<n_words;w++) {
+        uint64_t word = words[w];
+        while(word != 0) {
+            uint64_t number = 2*(64*w + __builtin_ctzll(word)) + 1;
+            word &= word - 1;
+            buffer += to_string(number);
+            buffer += ' ';
+            if(number == 1 && region->two_is_prime)
+                buffer += "2 ";
+        }
+        if(buffer.size() >= (1 << 20)) {
+            output<<buffer;
+            buffer.clear();
+        }
+    }
+    output<<buffer;
+    output.close();
+    munmap(data, size);
+    auto end_time = std::chrono::high_resolution_clock::now();
+    reduce_time = std::chrono::duration_cast<std::chrono::microseconds>( end_time - reduce_start_time ).count()/(double)(pow(10,6));
+    return std::chrono::duration_cast<std::chrono::microseconds>( end_time - start_time ).count()/(double)(pow(10,6));
+}
+
+int main(int argc, char* argv[]) {
+    // ./out counters runs counter microbenchmark instead of prime computation
+    if(argc > 1 && string(argv[1]) == "counters") {
+        counterBenchmark();
+        return 0;
+    }
+
+    // ./out query maps Primes.bitmap and answers queries from standard input
+    if(argc > 1 && string(argv[1]) == "query") {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        PrimeBitmap bitmap;
+        if(!bitmap.open(PRIME_BITMAP_FILE)) {
+            cerr<<"Could not open "<<PRIME_BITMAP_FILE<<", run ./out bitmap first"<<endl;
+            return 1;
+        }
+        auto end_time = std::chrono::high_resolution_clock::now();
+        cerr<<"Mapped bitmap of primes up to "<<bitmap.limit()<<" in "
+            <<std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count()/1000.0<<" ms"<<endl;
+        answerQueries(bitmap);
+        return 0;
+    }
+
     // n is number upto which prime numbers are to be tested
     int n, noOfThreads;
     // input file stream
@@ -116,16 +1091,139 @@ int main() {
 
 
     input_file.open("inp-params.txt");
-    primes_DAM_output_file.open("Primes-DAM.txt");
-    primes_SAM1_output_file.open("Primes-SAM1.txt");
-    primes_SAM2_output_file.open("Primes-SAM2.txt");
     time_output_file.open("Times.txt");
 
     // reading n and threads count from input file
     input_file>>n>>noOfThreads;
+
+    // ./out bitmap stores primes up to n as odd only bitmap file instead of text files
+    if(argc > 1 && string(argv[1]) == "bitmap") {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        if(!buildPrimeBitmap(n, noOfThreads, PRIME_BITMAP_FILE)) {
+            cerr<<"Could not write "<<PRIME_BITMAP_FILE<<endl;
+            return 1;
+        }
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>( end_time - start_time ).count()/(double)(pow(10,6));
+        time_output_file<<duration<<endl;
+        return 0;
+    }
+
+    // ./out resume computes primes upto n reusing ranges completed by earlier resumable runs
+    if(argc > 1 && string(argv[1]) == "resume") {
+        string counter_kind = "mutex";
+        input_file>>counter_kind;
+        time_output_file<<resumeMethod("DAM", n, noOfThreads, counter_kind)<<" ";
+        time_output_file<<resumeMethod("SAM1", n, noOfThreads, counter_kind)<<" ";
+        time_output_file<<resumeMethod("SAM2", n, noOfThreads, counter_kind)<<endl;
+        return 0;
+    }
+
+    // ./out stream [first] consumes primes in [first, n] in ascending order from a PrimeStream
+    // and prints their count, the largest one and memory used, nothing is written to files
+    if(argc > 1 && string(argv[1]) == "stream") {
+        uint64_t first = argc > 2 ? strtoull(argv[2], NULL, 10) : 0;
+        uint64_t N = argc > 3 ? strtoull(argv[3], NULL, 10) : n;
+        auto start_time = std::chrono::high_resolution_clock::now();
+        uint64_t count = 0, largest = 0, previous = 0;
+        bool ordered = true;
+        PrimeStream stream(first, N, noOfThreads);
+        stream.forEach([&](uint64_t prime) {
+            if(prime <= previous)
+                ordered = false;
+            previous = prime;
+            largest = prime;
+            count++;
+        });
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>( end_time - start_time ).count()/(double)(pow(10,6));
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        cout<<count<<" primes in ["<<first<<", "<<N<<"], largest "<<largest<<(ordered ? ", ascending" : ", NOT ascending")
+            <<", "<<duration<<" s, peak memory "<<usage.ru_maxrss/1024.0<<" MB"<<endl;
+        time_output_file<<duration<<endl;
+        return 0;
+    }
+
+    // ./out kernels compares trial division with the small prime kernel under every method
+    if(argc > 1 && string(argv[1]) == "kernels") {
+        string counter_kind = "mutex";
+        input_file>>counter_kind;
+        kernelBenchmark(n, noOfThreads, counter_kind);
+        return 0;
+    }
+
+    // ./out autotune [retune] runs primes upto n with the configuration picked for this host,
+    // which is read from Autotune.txt, or measured and stored there if missing or retune is given
+    if(argc > 1 && string(argv[1]) == "autotune") {
+        string counter_kind = "mutex";
+        input_file>>counter_kind;
+        char host[256] = "unknown";
+        gethostname(host, sizeof(host) - 1);
+        int logical_cpus = max(1, (int)thread::hardware_concurrency());
+        TuneConfig config = {"", 0, 1, 0};
+        vector<string> cache_lines;
+        ifstream cache_input(AUTOTUNE_CACHE_FILE);
+        string line;
+        while(getline(cache_input, line)) {
+            stringstream fields(line);
+            string cached_host, method;
+            int cpus, threads;
+            long chunk;
+            if(!(fields>>cached_host>>cpus>>method>>threads>>chunk))
+                continue;
+            if(cached_host == host && cpus == logical_cpus)
+                config = {method, threads, chunk, 0};
+            else
+                cache_lines.push_back(line);
+        }
+        cache_input.close();
+        if(config.method == "" || (argc > 2 && string(argv[2]) == "retune")) {
+            config = autotune(n, counter_kind);
+            ofstream cache(AUTOTUNE_CACHE_FILE);
+            for(string& cached:cache_lines)
+                cache<<cached<<endl;
+            cache<<host<<" "<<logical_cpus<<" "<<config.method<<" "<<config.threads<<" "<<config.chunk<<endl;
+        }
+        else
+            cout<<"using "<<config.method<<" with "<<config.threads<<" threads and chunk "<<config.chunk
+                <<" cached for "<<host<<" in "<<AUTOTUNE_CACHE_FILE<<endl;
+        ofstream primes_output("Primes-" + config.method + ".txt");
+        mutex primes_lock;
+        auto start_time = std::chrono::high_resolution_clock::now();
+        runMethod(config.method, 1, n, config.threads, counter_kind, primes_output, primes_lock, config.chunk);
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>( end_time - start_time ).count()/(double)(pow(10,6));
+        cout<<config.method<<" upto "<<n<<" took "<<duration<<" s"<<endl;
+        time_output_file<<duration<<endl;
+        return 0;
+    }
+
+    // ./out procs [P] runs DAM, SAM1 and SAM2 with P worker processes (m by default) instead of threads
+    if(argc > 1 && string(argv[1]) == "procs") {
+        int n_processes = argc > 2 ? atoi(argv[2]) : noOfThreads;
+        string methods[] = {"DAM", "SAM1", "SAM2"};
+        for(int i=0;i<3;i++) {
+            double reduce_time;
+            double duration = runProcesses(methods[i], n, n_processes, reduce_time);
+            cout<<methods[i]<<" with "<<n_processes<<" processes: "<<duration<<" s, reducer "<<reduce_time<<" s"<<endl;
+            if(i < 2)
+                time_output_file<<duration<<" ";
+            else
+                time_output_file<<duration<<endl;
+        }
+        return 0;
+    }
+
+    primes_DAM_output_file.open("Primes-DAM.txt");
+    primes_SAM1_output_file.open("Primes-SAM1.txt");
+    primes_SAM2_output_file.open("Primes-SAM2.txt");
     
-    // instantiating counter with initial value 1
-    Counter counter(1);
+    // instantiating counter with initial value 1, kind of counter is an optional third parameter
+    // mutex (default), atomic, tree or sharded
+    string counter_kind = "mutex";
+    input_file>>counter_kind;
+    Counter* counter = makeCounter(counter_kind, 1, noOfThreads);
 
     // declaring threads with count given in input file 
     thread threads[noOfThreads];
@@ -134,7 +1232,7 @@ int main() {
     auto start_time = std::chrono::high_resolution_clock::now();
     // creating all threads
     for(int i=1;i<=noOfThreads;i++)
-        threads[i-1] = thread(DAM, &counter, n, i);
+        threads[i-1] = thread(DAM, counter, n, i, ref(primes_DAM_output_file), ref(DAM_file_lock));
     // joining all the threads
     for(int i=1;i<=noOfThreads;i++)
         threads[i-1].join();
@@ -149,7 +1247,7 @@ int main() {
     start_time = std::chrono::high_resolution_clock::now();
     // creating all threads
     for(int i=1;i<=noOfThreads;i++)
-        threads[i-1] = thread(SAM1, n, noOfThreads, i);
+        threads[i-1] = thread(SAM1, 1, n, noOfThreads, i, ref(primes_SAM1_output_file), ref(SAM1_file_lock));
     // joining all the threads
     for(int i=1;i<=noOfThreads;i++)
         threads[i-1].join();
@@ -164,7 +1262,7 @@ int main() {
     start_time = std::chrono::high_resolution_clock::now();
     // creating all threads
     for(int i=1;i<=noOfThreads;i++)
-        threads[i-1] = thread(SAM2, n, noOfThreads, i);
+        threads[i-1] = thread(SAM2, 1, n, noOfThreads, i, ref(primes_SAM2_output_file), ref(SAM2_file_lock));
     // joining all the threads
     for(int i=1;i<=noOfThreads;i++)
         threads[i-1].join();
@@ -175,6 +1273,8 @@ int main() {
     time_output_file<<duration<<endl;
 
 
+    delete counter;
+
     // cleanup, closing all file streams
     primes_DAM_output_file.close();
     primes_SAM1_output_file.close();
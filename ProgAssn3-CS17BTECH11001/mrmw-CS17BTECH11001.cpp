@@ -3,15 +3,21 @@
 #include <thread>
 #include <chrono>
 #include <mutex>
+#include <shared_mutex>
 #include <ctime>
 #include <math.h>
 #include <unistd.h>
 #include <random>
 #include <atomic>
-#include <sstream>
-#include <map>
+#include <iomanip>
+#include <queue>
+#include <tuple>
 #include <vector>
 #include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+#include <functional>
 using namespace std;
 
 // random number generator
@@ -22,6 +28,12 @@ ofstream output_file;
 
 // parameters of input file
 int n_threads, capacity, n_snapshots;
+// number of registers read by each snapshot, 0 reads all of them
+int query_size;
+// number of snapshot threads
+int n_scanners;
+// number of writes by each writer thread, 0 runs writers until snapshot threads finish
+long n_writes;
 double lambda_1, lambda_2;
 
 // mutex lock for output file writing
@@ -39,8 +51,66 @@ double avg_completion_time;
 // worst case time for snapshot
 double worst_case_time;
 
+// histogram with power of two buckets, bucket 0 counts zeros and
+// bucket b counts values in [2^(b-1), 2^b)
+class Histogram {
+    vector<long> buckets;
+public:
+    Histogram() : buckets(64, 0) {}
+
+    // counting given value in its bucket
+    void add(long value) {
+        int bucket = value <= 0 ? 0 : 64 - __builtin_clzl(value);
+        buckets[bucket]++;
+    }
+
+    // adding counts of other histogram
+    void merge(const Histogram& other) {
+        for(size_t i=0;i<buckets.size();i++)
+            buckets[i] += other.buckets[i];
+    }
+
+    // printing non empty buckets
+    void print(string name) {
+        cout<<name<<endl;
+        for(size_t i=0;i<buckets.size();i++) {
+            if(buckets[i] == 0)
+                continue;
+            if(i == 0)
+                cout<<"  0: "<<buckets[i]<<endl;
+            else
+                cout<<"  ["<<(1L << (i-1))<<", "<<(1L << i)<<"): "<<buckets[i]<<endl;
+        }
+    }
+};
+
+// histogram of snapshot times in microseconds
+Histogram scan_time_histogram;
+// histogram of collects repeated by a snapshot after its first collect
+Histogram retry_histogram;
+// operations per second of each writer thread and each snapshot thread
+vector<double> writer_throughput;
+vector<double> scanner_throughput;
+// snapshot times in microseconds of all snapshot threads, used for percentiles
+vector<double> scan_times;
+
+// results of one snapshot object, printed side by side after all objects have run
+class BenchmarkResult {
+public:
+    string name;
+    double writes_per_second;
+    double snapshots_per_second;
+    double avg_time;
+    double p50_time;
+    double p99_time;
+    double worst_time;
+};
+vector<BenchmarkResult> benchmark_results;
+
 // Stamped Reg class
 template <class T>
+// stamp is the version of the write, drawn by the register from its own 64 bit counter,
+// so every write into a register gets a stamp no other write into it had
 class Stamped_Reg {
 public:
     T value;
@@ -48,31 +118,61 @@ public:
     long thread_id;
 };
 
+// bits of packed register word, value takes lower 32 bits, thread_id+1 next 10 bits
+// and version modulo 2^22 the upper bits
+const int WRITER_SHIFT = 32;
+const int STAMP_SHIFT = 42;
+const uint64_t WRITER_MASK = (1UL << 10) - 1;
+const uint64_t STAMP_MASK = (1UL << 22) - 1;
+// writes into a packed register after which its version repeats
+const unsigned long PACKED_STAMP_PERIOD = STAMP_MASK + 1;
+// largest number of writers which fits into packed register
+const int MAX_PACKED_WRITERS = WRITER_MASK;
+// tag of a collected register, thread_id+1 takes lower 20 bits and stamp the upper bits,
+// every write into a register has its own version, hence two reads of a register
+// saw the same write iff their tags are equal. Locked and indirect layouts keep the
+// lower 44 bits of their 64 bit version in a tag
+const int TAG_STAMP_SHIFT = 20;
+const uint64_t TAG_WRITER_MASK = (1UL << TAG_STAMP_SHIFT) - 1;
+// largest number of writers which fits into tags
+const int MAX_WRITERS = TAG_WRITER_MASK;
+
 // atomic Stamped Reg class
 template <class T>
 class StampedReg{
 public:
+    // value is stored inline in the register
+    static const bool indirect = false;
+    // whole 64 bit version is kept, it never repeats
+    static const bool stamp_wraps = false;
+
     // atomic Stamped_Reg member 
     atomic<Stamped_Reg<T>> stamped_reg;
+    // number of versions handed out to writes into this register
+    atomic<uint64_t> versions;
 
     // constructor
     StampedReg() {
-        stamped_reg.store({0, 0, -1});
+        stamped_reg.store({T(), 0, -1});
+        versions.store(0);
     }
 
     // parameterized constructor
     StampedReg(T value, long stamp, long thread_id) {
         stamped_reg.store({value, stamp, thread_id});
+        versions.store(stamp);
     }
 
     // copy constructor
     StampedReg(const StampedReg<T> &other) {
         stamped_reg.store(other.stamped_reg.load());
+        versions.store(other.versions.load());
     }
 
     // copy assignment operator 
     StampedReg &operator=(const StampedReg<T>& other) {
         stamped_reg.store(other.stamped_reg.load());
+        versions.store(other.versions.load());
         return *this;
     }
 
@@ -88,236 +188,1077 @@ public:
         || (stamped_reg.load().thread_id != other.stamped_reg.load().thread_id);
     } 
 
+    // reading value, stamp and thread_id with one atomic load
+    Stamped_Reg<T> load() const {
+        return stamped_reg.load();
+    }
+
+    // writing value and thread_id with a new version as stamp, with one atomic store
+    // versions come from fetch_add, hence concurrent writers never wait for each other
+    void write(T value, long thread_id) {
+        long stamp = versions.fetch_add(1) + 1;
+        stamped_reg.store({value, stamp, thread_id});
+    }
+
+    // reading value into given reference and returning stamp and thread_id+1 as one tag
+    uint64_t loadTagged(T& value) const {
+        Stamped_Reg<T> reg = stamped_reg.load();
+        value = reg.value;
+        return ((uint64_t)reg.stamp << TAG_STAMP_SHIFT) | ((uint64_t)(reg.thread_id + 1) & TAG_WRITER_MASK);
+    }
+
 };
 
-// MRMW wait free snapshot class
+// lock free Stamped Reg class which packs value, stamp and thread_id into one 64 bit word
+// atomic<Stamped_Reg<T>> is bigger than 16 bytes and libatomic guards it with a lock,
+// packed word is loaded and stored with plain atomic instructions
+// versions are kept modulo 2^22 and a write installs the version after the installed one
+// with compare and swap, so a register shows the same tag again only after exactly a
+// multiple of 2^22 writes were installed into it, which snapshots detect through write
+// version (see MRMW_WFSnapshot::stampsMayRepeat)
+// a write retries its compare and swap while other writers install into the same register,
+// hence update with this layout is lock free, not wait free
+template <class T>
+class PackedStampedReg {
+    static_assert(sizeof(T) <= sizeof(uint32_t) && is_trivially_copyable<T>::value,
+        "packed register holds trivially copyable values of at most 32 bits");
+    static_assert(atomic<uint64_t>::is_always_lock_free, "packed register word must be lock free");
+
+    // packed value, stamp and thread_id
+    atomic<uint64_t> word;
+
+    static uint64_t pack(T value, long stamp, long thread_id) {
+        uint32_t value_bits = 0;
+        memcpy(&value_bits, &value, sizeof(T));
+        return (((uint64_t)stamp & STAMP_MASK) << STAMP_SHIFT)
+            | (((uint64_t)(thread_id + 1) & WRITER_MASK) << WRITER_SHIFT)
+            | value_bits;
+    }
+
+public:
+    // value is stored inline in the register
+    static const bool indirect = false;
+    // version repeats every PACKED_STAMP_PERIOD writes
+    static const bool stamp_wraps = true;
+
+    // constructor
+    PackedStampedReg() {
+        word.store(pack(T(), 0, -1));
+    }
+
+    // parameterized constructor
+    PackedStampedReg(T value, long stamp, long thread_id) {
+        word.store(pack(value, stamp, thread_id));
+    }
+
+    // copy constructor
+    PackedStampedReg(const PackedStampedReg<T> &other) {
+        word.store(other.word.load());
+    }
+
+    // reading value, stamp and thread_id with one atomic load
+    Stamped_Reg<T> load() const {
+        uint64_t bits = word.load();
+        uint32_t value_bits = (uint32_t)bits;
+        Stamped_Reg<T> reg;
+        memcpy(&reg.value, &value_bits, sizeof(T));
+        reg.stamp = (long)(bits >> STAMP_SHIFT);
+        reg.thread_id = (long)((bits >> WRITER_SHIFT) & WRITER_MASK) - 1;
+        return reg;
+    }
+
+    // writing value and thread_id with the version after the installed one as stamp
+    // drawing the version and installing it is one compare and swap, hence a writer
+    // stalled between the two can't install a version older than the current one
+    // lock free, some write succeeds whenever a compare and swap fails
+    void write(T value, long thread_id) {
+        uint64_t bits = word.load();
+        while(!word.compare_exchange_weak(bits, pack(value, (long)(bits >> STAMP_SHIFT) + 1, thread_id))) {}
+    }
+
+    // reading value into given reference and returning stamp and thread_id+1 as one tag
+    uint64_t loadTagged(T& value) const {
+        uint64_t bits = word.load();
+        uint32_t value_bits = (uint32_t)bits;
+        memcpy(&value, &value_bits, sizeof(T));
+        return ((bits >> STAMP_SHIFT) << TAG_STAMP_SHIFT) | ((bits >> WRITER_SHIFT) & WRITER_MASK);
+    }
+};
+
+// register which points to an immutable node holding value, stamp and thread_id
+// values of any size are read and written with one lock free pointer load or exchange,
+// update installs a node from the writer's pool and the replaced node is reused with
+// epoch based reclamation by the snapshot object, since collects may still be reading it
+template <class T>
+class IndirectStampedReg {
+    static_assert(atomic<Stamped_Reg<T>*>::is_always_lock_free, "register pointer must be lock free");
+
+    // node of the latest write, never modified while it is installed
+    atomic<Stamped_Reg<T>*> node;
+    // number of versions handed out to writes into this register
+    atomic<uint64_t> versions;
+
+public:
+    // value is stored in a node outside the register
+    static const bool indirect = true;
+    // whole 64 bit version is kept, it never repeats
+    static const bool stamp_wraps = false;
+
+    // constructor
+    IndirectStampedReg() {
+        node.store(new Stamped_Reg<T>{T(), 0, -1});
+        versions.store(0);
+    }
+
+    // parameterized constructor
+    IndirectStampedReg(T value, long stamp, long thread_id) {
+        node.store(new Stamped_Reg<T>{value, stamp, thread_id});
+        versions.store(stamp);
+    }
+
+    // copy constructor, copying the node so that every register owns its own
+    IndirectStampedReg(const IndirectStampedReg<T> &other) {
+        node.store(new Stamped_Reg<T>(*other.node.load()));
+        versions.store(other.versions.load());
+    }
+
+    ~IndirectStampedReg() {
+        delete node.load();
+    }
+
+    // reading value, stamp and thread_id with one atomic load
+    Stamped_Reg<T> load() const {
+        return *node.load();
+    }
+
+    // filling given node with value, thread_id and a new version as stamp, installing it
+    // and returning the replaced node, which the caller retires
+    Stamped_Reg<T>* write(Stamped_Reg<T>* new_node, T value, long thread_id) {
+        new_node->value = value;
+        new_node->stamp = versions.fetch_add(1) + 1;
+        new_node->thread_id = thread_id;
+        return node.exchange(new_node);
+    }
+
+    // reading value into given reference and returning stamp and thread_id+1 as one tag
+    uint64_t loadTagged(T& value) const {
+        const Stamped_Reg<T>* current = node.load();
+        value = current->value;
+        return ((uint64_t)current->stamp << TAG_STAMP_SHIFT) | ((uint64_t)(current->thread_id + 1) & TAG_WRITER_MASK);
+    }
+};
+
+// collect stored as structure of arrays, tags and values of registers are kept in
+// separate plain arrays so that two collects are compared with one memcmp of tags
+template <class T>
+class CollectBuffer {
+public:
+    uint64_t* tags;
+    T* values;
+};
+
+// writer of the register a tag was read from
+inline long tagWriter(uint64_t tag) {
+    return (long)(tag & TAG_WRITER_MASK) - 1;
+}
+
+// write version masks, writes in progress are bounded by number of writers
+// and can't overflow into completed writes
+const unsigned long WRITES_IN_PROGRESS = 0xffffffffUL;
+const unsigned long COMPLETED_WRITE = 1UL << 32;
+
+// epoch announced by a thread which is not inside snapshot
+const unsigned long QUIESCENT = ~0UL;
+
+// subset of registers read by a snapshot, either count registers starting at first
+// or count registers at given indices
+class Query {
+public:
+    const int* indices;
+    int first;
+    int count;
+
+    // register read at position k of query
+    int location(int k) const {
+        return indices != NULL ? indices[k] : first + k;
+    }
+};
+
+// state of each thread using the snapshot object, preallocated for every thread id
+// so that snapshot and update do not allocate once the object is warmed up
 template <class T>
+class ThreadState {
+public:
+    // epoch announced while thread is inside snapshot, QUIESCENT otherwise
+    atomic<unsigned long> epoch;
+    // buffers for the two most recent collects
+    CollectBuffer<T> aa;
+    CollectBuffer<T> bb;
+    // marks writers which have been seen moving once
+    bool* can_help;
+    // result of most recent snapshot returned to the caller
+    T* result;
+    // distinct registers of an index query, position of every register among them
+    // (-1 if not in the query) and position of the k-th index among them
+    int* distinct;
+    int* position;
+    int* slot;
+    // collects repeated after the first one by most recent snapshot
+    int retries;
+    // most recent snapshot borrowed a help snapshot since packed versions may have come round
+    bool borrowed_on_wrap;
+    // updates finished by this thread as a writer, counted after its help snapshot is published
+    atomic<unsigned long> updates;
+    // updates of every writer when most recent snapshot fell back to double collect
+    unsigned long* updates_seen;
+    // help snapshots retired by this writer along with the epoch of retirement,
+    // used as a ring starting at retired_head
+    vector<pair<unsigned long, T*>> retired;
+    size_t retired_head;
+    // register nodes replaced by this writer (indirect registers only), used the same way
+    vector<pair<unsigned long, Stamped_Reg<T>*>> retired_nodes;
+    size_t retired_nodes_head;
+    // padding to keep epochs of different threads on different cache lines
+    char padding[64];
+
+    ThreadState() {
+        epoch.store(QUIESCENT);
+        aa.tags = new uint64_t[capacity];
+        aa.values = new T[capacity];
+        bb.tags = new uint64_t[capacity];
+        bb.values = new T[capacity];
+        can_help = new bool[n_threads];
+        result = new T[capacity];
+        distinct = new int[capacity];
+        position = new int[capacity];
+        slot = new int[capacity];
+        fill(position, position + capacity, -1);
+        retries = 0;
+        borrowed_on_wrap = false;
+        updates.store(0);
+        updates_seen = new unsigned long[n_threads];
+        retired_head = 0;
+        retired_nodes_head = 0;
+    }
+
+    ~ThreadState() {
+        delete[] aa.tags;
+        delete[] aa.values;
+        delete[] bb.tags;
+        delete[] bb.values;
+        delete[] can_help;
+        delete[] result;
+        delete[] distinct;
+        delete[] position;
+        delete[] slot;
+        delete[] updates_seen;
+        for(size_t i=retired_head;i<retired.size();i++)
+            delete[] retired[i].second;
+        for(size_t i=retired_nodes_head;i<retired_nodes.size();i++)
+            delete retired_nodes[i].second;
+    }
+};
+
+// MRMW wait free snapshot class
+// R is the register layout, PackedStampedReg, StampedReg or IndirectStampedReg
+// snapshots are wait free with every layout, update is wait free with the locked and
+// indirect layouts and lock free with the packed one, whose writes retry compare and swap
+// every writer publishes the snapshot taken by its latest update through an atomic
+// pointer, a published snapshot is never modified and is reused by its writer with
+// epoch based reclamation once no snapshot which might have borrowed it is running
+template <class T, class R>
 class MRMW_WFSnapshot {
     // REG array
-    vector<StampedReg<T>> Reg;
-    // HelpSnap array consists of snapshot for each thread
-    vector<vector<T>> HelpSnap;
-public:
-    MRMW_WFSnapshot() {}
+    vector<R> Reg;
+    // HelpSnap array consists of pointer to latest snapshot of each writer
+    vector<atomic<T*>> HelpSnap;
+    // writers use thread ids 0 to n_threads-1, scanners use the ids after them
+    vector<ThreadState<T>> states;
+    // global epoch advanced on every retirement of a help snapshot
+    atomic<unsigned long> global_epoch;
+    // version of Reg array, lower 32 bits count writes in progress and
+    // upper 32 bits count completed writes
+    atomic<unsigned long> write_version;
 
-    MRMW_WFSnapshot(T init) {
-        for(int i=0;i<capacity;i++)
-            Reg.push_back(StampedReg<T>(init, 0, -1));
-        HelpSnap.assign(n_threads, vector<T>(capacity));
+    // announcing the epoch in which thread starts reading help snapshots
+    void enterEpoch(int thread_id) {
+        states[thread_id].epoch.store(global_epoch.load());
     }
-    
-    // collection of Reg array
-    StampedReg<T>* collect() {
-        StampedReg<T>* copy = new StampedReg<T>[capacity];
-        for(int j=0;j<capacity;j++) {
-            copy[j] = Reg[j];
+
+    // announcing that thread holds no reference to help snapshots
+    void exitEpoch(int thread_id) {
+        states[thread_id].epoch.store(QUIESCENT);
+    }
+
+    // oldest epoch announced by any thread inside snapshot
+    unsigned long minActiveEpoch() {
+        unsigned long min_epoch = QUIESCENT;
+        for(size_t i=0;i<states.size();i++)
+            min_epoch = min(min_epoch, states[i].epoch.load());
+        return min_epoch;
+    }
+
+    // array for next help snapshot of writer, reusing a retired one if it is safe
+    T* allocateSnap(ThreadState<T>& state) {
+        if(state.retired_head < state.retired.size()
+            && state.retired[state.retired_head].first < minActiveEpoch()) {
+            T* snap = state.retired[state.retired_head].second;
+            state.retired_head++;
+            // ring is empty, restarting it without releasing its memory
+            if(state.retired_head == state.retired.size()) {
+                state.retired.clear();
+                state.retired_head = 0;
+            }
+            return snap;
         }
-        return copy;
+        return new T[capacity];
     }
-    
-    // update at given location with given value by given thread_id
-    void update(int thread_id, int location, T value, long stamp) {
-        StampedReg<T> old_value = Reg[location];
-        // old_value.stamped_reg.load().thread_id = thread_id;
-        // old_value.stamped_reg.load().value = value;
-        // old_value.stamped_reg.load().stamp = stamp;
-        StampedReg<T> new_value(value, stamp, thread_id);
-        Reg[location] = new_value;
-        // taking snapshot
-        T* snap_shot = this->snapshot();
-        // storing snapshot at given thread_id
-        for(int i=0;i<capacity;i++)
-            HelpSnap[thread_id][i] = snap_shot[i];
-        //delete[] snap_shot;
+
+    // node for next write into an indirect register, reusing a retired one if it is safe
+    Stamped_Reg<T>* allocateNode(ThreadState<T>& state) {
+        if(state.retired_nodes_head < state.retired_nodes.size()
+            && state.retired_nodes[state.retired_nodes_head].first < minActiveEpoch()) {
+            Stamped_Reg<T>* node = state.retired_nodes[state.retired_nodes_head].second;
+            state.retired_nodes_head++;
+            if(state.retired_nodes_head == state.retired_nodes.size()) {
+                state.retired_nodes.clear();
+                state.retired_nodes_head = 0;
+            }
+            return node;
+        }
+        return new Stamped_Reg<T>;
     }
 
+    // writing register at location, indirect registers get a node from the writer's pool
+    void writeRegister(ThreadState<T>& state, int location, T value, int thread_id) {
+        if constexpr (R::indirect) {
+            Stamped_Reg<T>* old_node = Reg[location].write(allocateNode(state), value, thread_id);
+            // collects entering after this increment cannot read old node
+            unsigned long epoch = global_epoch.fetch_add(1);
+            state.retired_nodes.push_back(make_pair(epoch, old_node));
+        }
+        else
+            Reg[location].write(value, thread_id);
+    }
 
-    // snapshot of Reg array
-    T* snapshot() {
-        // boolean array representing if some thread can help at given location of Reg array
-        bool can_help[n_threads] = {false};
+    // retiring help snapshot which is no longer reachable from HelpSnap
+    void retireSnap(ThreadState<T>& state, T* snap) {
+        // snapshots entering after this increment cannot borrow snap
+        unsigned long epoch = global_epoch.fetch_add(1);
+        state.retired.push_back(make_pair(epoch, snap));
+    }
+
+    // snapshot of registers in query into given array, thread must be inside an epoch
+    // only queried registers are collected, so cost scales with query size
+    void snapshotInto(int thread_id, const Query& query, T* result) {
+        ThreadState<T>& state = states[thread_id];
+        CollectBuffer<T> aa = state.aa;
+        CollectBuffer<T> bb = state.bb;
+        // fast path, a single collect is a snapshot if no write was in progress
+        // before it and no write started until it finished
+        unsigned long version = write_version.load();
+        state.retries = 0;
+        state.borrowed_on_wrap = false;
+        if constexpr (R::stamp_wraps) {
+            if(before_collect)
+                before_collect(thread_id);
+        }
         // initial collect
-        StampedReg<T>* aa = collect();
+        collect(query, aa);
+        if((version & WRITES_IN_PROGRESS) == 0 && write_version.load() == version) {
+            copy(aa.values, aa.values + query.count, result);
+            return;
+        }
+        // writers are active, falling back to double collect with helping
+        // boolean array representing if some thread can help at given location of Reg array
+        fill(state.can_help, state.can_help + n_threads, false);
+        if constexpr (R::stamp_wraps) {
+            for(int w=0;w<n_threads;w++)
+                state.updates_seen[w] = states[w].updates.load();
+        }
         while(true) {
-            StampedReg<T>* bb = collect();
-            bool clean_double_collect = true;
+            if constexpr (R::stamp_wraps) {
+                if(before_collect)
+                    before_collect(thread_id);
+            }
+            // write version before the collect of bb, version is the one before the collect of aa
+            unsigned long next_version = write_version.load();
+            collect(query, bb);
+            state.retries++;
+            // tags are plain contiguous memory, compared with one vectorized memcmp
+            bool clean_double_collect = memcmp(aa.tags, bb.tags, query.count * sizeof(uint64_t)) == 0;
 
-            for(int i=0;i<capacity;i++) {
-                if(aa[i] != bb[i]) {
+            if constexpr (R::stamp_wraps) {
+                // enough writes were installed between the two collects for a packed version
+                // to come round again, so equal tags prove nothing. A writer which finished two
+                // updates since updates_seen was read published a snapshot taken after this one
+                // started, and once version is read after updates_seen that many writes leave
+                // such a writer, so the loop still ends
+                if(clean_double_collect && stampsMayRepeat(version, write_version.load())) {
                     clean_double_collect = false;
-                    break;
+                    for(int w=0;w<n_threads;w++) {
+                        if(states[w].updates.load() - state.updates_seen[w] >= 2) {
+                            T* help_snap = HelpSnap[w].load();
+                            for(int l=0;l<query.count;l++)
+                                result[l] = help_snap[query.location(l)];
+                            state.borrowed_on_wrap = true;
+                            return;
+                        }
+                    }
                 }
             }
 
             // returning bb in case of clean double collect
             if(clean_double_collect) {
                 //cout<<"clean collect"<<endl;
-                T* result = new T[capacity];
-                for(int j=0;j<capacity;j++) 
-                    result[j] = bb[j].stamped_reg.load().value;
-                //delete[] bb;
-                return result;
+                copy(bb.values, bb.values + query.count, result);
+                return;
             }
 
-            for(int i=0;i<capacity;i++) {
-                if(bb[i] != aa[i]) {
-                    StampedReg<T> mismatched_loc = bb[i];
-                    long thread_id = mismatched_loc.stamped_reg.load().thread_id;
+            for(int k=0;k<query.count;k++) {
+                if(aa.tags[k] != bb.tags[k]) {
+                    long thread_id = tagWriter(bb.tags[k]);
                     // checking if given thread can help at given location
-                    if(can_help[thread_id]) {
+                    // writer moved twice during this snapshot, hence its published
+                    // snapshot was taken after this snapshot started
+                    if(state.can_help[thread_id]) {
                         //cout<<"helped"<<endl;
-                        T* result = new T[capacity];
-                        for(int j=0;j<capacity;j++) 
-                            result[j] = HelpSnap[thread_id][i];
-                        return result;
+                        // borrowed snapshot can't be reused while thread is inside epoch
+                        // it covers every register, hence it covers the query as well
+                        T* help_snap = HelpSnap[thread_id].load();
+                        for(int l=0;l<query.count;l++)
+                            result[l] = help_snap[query.location(l)];
+                        return;
                     }
                     else
-                        can_help[thread_id] = true;
+                        state.can_help[thread_id] = true;
                 }
             }
-            //delete[] aa;
-            aa = bb;
+            swap(aa, bb);
+            version = next_version;
+        }
+    }
+
+    // query of every register
+    Query fullQuery() {
+        Query query = {NULL, 0, capacity};
+        return query;
+    }
+
+    // snapshot of given query into result buffer of thread
+    T* snapshotQuery(int thread_id, const Query& query) {
+        T* result = states[thread_id].result;
+        enterEpoch(thread_id);
+        snapshotInto(thread_id, query, result);
+        exitEpoch(thread_id);
+        return result;
+    }
+
+public:
+    // called with the snapshot's thread_id before every collect of a snapshot of packed
+    // registers, only tests set it, to write while a snapshot is in progress
+    function<void(int)> before_collect;
+
+    MRMW_WFSnapshot() {}
+
+    // registers start at version first_stamp, which only tests set
+    MRMW_WFSnapshot(T init, int n_scanners, long first_stamp = 0) : HelpSnap(n_threads), states(n_threads + n_scanners) {
+        for(int i=0;i<capacity;i++)
+            Reg.push_back(R(init, first_stamp, -1));
+        for(int i=0;i<n_threads;i++)
+            HelpSnap[i].store(NULL);
+        global_epoch.store(0);
+        write_version.store(0);
+    }
+    
+    // collection of Reg array into given buffer
+    void collect(CollectBuffer<T>& copy) {
+        collect(fullQuery(), copy);
+    }
+
+    // collection of registers in query into given buffer, k-th register of query
+    // is read with one atomic load into tags[k] and values[k]
+    // with indirect registers caller must be inside an epoch, as snapshots are
+    void collect(const Query& query, CollectBuffer<T>& copy) {
+        for(int k=0;k<query.count;k++) {
+            copy.tags[k] = Reg[query.location(k)].loadTagged(copy.values[k]);
+        }
+    }
+    
+    // collection of registers in query by given thread_id, safe with every register layout
+    void collect(int thread_id, const Query& query, CollectBuffer<T>& copy) {
+        enterEpoch(thread_id);
+        collect(query, copy);
+        exitEpoch(thread_id);
+    }
+
+    // number of collects repeated after the first one by latest snapshot of thread_id
+    int retries(int thread_id) {
+        return states[thread_id].retries;
+    }
+
+    // true if latest snapshot of thread_id did not trust equal tags because packed
+    // versions may have come round, and borrowed a help snapshot instead
+    bool borrowedOnWrap(int thread_id) {
+        return states[thread_id].borrowed_on_wrap;
+    }
+
+    // current write version, lower 32 bits count writes in progress and upper 32 bits completed writes
+    unsigned long writeVersion() {
+        return write_version.load();
+    }
+
+    // true if a packed version may have come round again in a register read once while write
+    // version was before and once while it was after, every write installed in between was in
+    // progress at before or started by after, so fewer such writes than PACKED_STAMP_PERIOD
+    // can't repeat a version
+    static bool stampsMayRepeat(unsigned long before, unsigned long after) {
+        unsigned long started = (after >> 32) + (after & WRITES_IN_PROGRESS);
+        return started - (before >> 32) >= PACKED_STAMP_PERIOD;
+    }
+
+    // update at given location with given value by given thread_id
+    // stamp of the write is a new version drawn by the register itself
+    void update(int thread_id, int location, T value) {
+        ThreadState<T>& state = states[thread_id];
+        write_version.fetch_add(1);
+        writeRegister(state, location, value, thread_id);
+        // ending write in progress and counting it as completed
+        write_version.fetch_add(COMPLETED_WRITE - 1);
+        // taking snapshot into an array which no other thread can see yet
+        T* snap_shot = allocateSnap(state);
+        enterEpoch(thread_id);
+        snapshotInto(thread_id, fullQuery(), snap_shot);
+        exitEpoch(thread_id);
+        // publishing complete snapshot at given thread_id
+        T* old_snap_shot = HelpSnap[thread_id].exchange(snap_shot);
+        if(old_snap_shot != NULL)
+            retireSnap(state, old_snap_shot);
+        state.updates++;
+    }
+
+
+    // snapshot of Reg array by given thread_id
+    // returned array is owned by the snapshot object and is valid until next snapshot by same thread_id
+    T* snapshot(int thread_id) {
+        return snapshotQuery(thread_id, fullQuery());
+    }
+
+    // snapshot of registers at given indices, linearizable over those registers only
+    // k-th value of returned array belongs to indices[k], at most capacity indices are allowed
+    // a register repeated in indices would show one write as two moves of its writer and a
+    // stale HelpSnap would be borrowed, hence only distinct registers are collected and then
+    // copied to every index which repeats them
+    T* snapshot(int thread_id, const vector<int>& indices) {
+        ThreadState<T>& state = states[thread_id];
+        int count = 0;
+        for(size_t k=0;k<indices.size();k++) {
+            int j = indices[k];
+            if(state.position[j] < 0) {
+                state.position[j] = count;
+                state.distinct[count++] = j;
+            }
+            state.slot[k] = state.position[j];
         }
+        for(int d=0;d<count;d++)
+            state.position[state.distinct[d]] = -1;
+        Query query = {state.distinct, 0, count};
+        T* result = snapshotQuery(thread_id, query);
+        // slot[k] is at most k, so going down from the end never overwrites a value still to be copied
+        for(int k=(int)indices.size()-1;k>=0;k--)
+            result[k] = result[state.slot[k]];
+        return result;
+    }
+
+    // snapshot of count registers starting at first, linearizable over those registers only
+    T* snapshot(int thread_id, int first, int count) {
+        Query query = {NULL, first, count};
+        return snapshotQuery(thread_id, query);
     }
 
     ~MRMW_WFSnapshot() {
         Reg.clear();
         for(int i=0;i<n_threads;i++)
-            HelpSnap[i].clear();
+            delete[] HelpSnap[i].load();
+    }
+};
+
+// per thread buffers of coarse grained baselines, only result is used by
+// locked and seqlock snapshots, RCU snapshot also uses epoch and retired arrays
+template <class T>
+class BaselineThreadState {
+public:
+    // epoch announced while thread holds a reference to an array, QUIESCENT otherwise
+    atomic<unsigned long> epoch;
+    // result of most recent snapshot returned to the caller
+    T* result;
+    // times snapshot was restarted by most recent snapshot
+    int retries;
+    // arrays retired by this thread along with the epoch of retirement,
+    // used as a ring starting at retired_head
+    vector<pair<unsigned long, T*>> retired;
+    size_t retired_head;
+    // padding to keep epochs of different threads on different cache lines
+    char padding[64];
+
+    BaselineThreadState() {
+        epoch.store(QUIESCENT);
+        result = new T[capacity];
+        retries = 0;
+        retired_head = 0;
+    }
+
+    ~BaselineThreadState() {
+        delete[] result;
+        for(size_t i=retired_head;i<retired.size();i++)
+            delete[] retired[i].second;
+    }
+};
+
+// baseline snapshot guarded by one reader writer lock, update takes it exclusively
+// and snapshot takes it shared, hence writers block snapshots and vice versa
+template <class T>
+class LockedSnapshot {
+    vector<T> Reg;
+    vector<BaselineThreadState<T>> states;
+    shared_mutex reg_lock;
+
+public:
+    LockedSnapshot(T init, int n_scanners) : Reg(capacity, init), states(n_threads + n_scanners) {}
+
+    int retries(int thread_id) {
+        return states[thread_id].retries;
+    }
+
+    void update(int, int location, T value) {
+        unique_lock<shared_mutex> guard(reg_lock);
+        Reg[location] = value;
+    }
+
+    T* snapshot(int thread_id) {
+        T* result = states[thread_id].result;
+        shared_lock<shared_mutex> guard(reg_lock);
+        copy(Reg.begin(), Reg.end(), result);
+        return result;
+    }
+
+    T* snapshot(int thread_id, const vector<int>& indices) {
+        T* result = states[thread_id].result;
+        shared_lock<shared_mutex> guard(reg_lock);
+        for(size_t k=0;k<indices.size();k++)
+            result[k] = Reg[indices[k]];
+        return result;
+    }
+
+    T* snapshot(int thread_id, int first, int count) {
+        T* result = states[thread_id].result;
+        shared_lock<shared_mutex> guard(reg_lock);
+        copy(Reg.begin() + first, Reg.begin() + first + count, result);
+        return result;
+    }
+};
+
+// baseline snapshot guarded by one sequence counter over the whole array
+// sequence is odd while a write is in progress, writers take it in turns by moving
+// it from even to odd and snapshot repeats its copy until sequence was even and
+// unchanged around it, hence snapshots never block writers but may starve
+template <class T>
+class SeqlockSnapshot {
+    // values are atomics read and written relaxed, so a torn copy is discarded without a data race
+    vector<atomic<T>> Reg;
+    vector<BaselineThreadState<T>> states;
+    atomic<unsigned long> sequence;
+
+    // copies registers in query into result until the copy is consistent
+    void snapshotInto(int thread_id, const Query& query, T* result) {
+        BaselineThreadState<T>& state = states[thread_id];
+        state.retries = -1;
+        unsigned long begin_sequence, end_sequence;
+        do {
+            state.retries++;
+            begin_sequence = sequence.load(memory_order_acquire);
+            if(begin_sequence & 1)
+                continue;
+            for(int k=0;k<query.count;k++)
+                result[k] = Reg[query.location(k)].load(memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            end_sequence = sequence.load(memory_order_relaxed);
+        } while((begin_sequence & 1) || begin_sequence != end_sequence);
+    }
+
+public:
+    SeqlockSnapshot(T init, int n_scanners) : Reg(capacity), states(n_threads + n_scanners) {
+        for(int i=0;i<capacity;i++)
+            Reg[i].store(init);
+        sequence.store(0);
+    }
+
+    int retries(int thread_id) {
+        return states[thread_id].retries;
+    }
+
+    void update(int, int location, T value) {
+        unsigned long current = sequence.load(memory_order_relaxed);
+        // waiting for even sequence and making it odd
+        while((current & 1) || !sequence.compare_exchange_weak(current, current + 1, memory_order_acquire)) {
+            this_thread::yield();
+            current = sequence.load(memory_order_relaxed);
+        }
+        atomic_thread_fence(memory_order_release);
+        Reg[location].store(value, memory_order_relaxed);
+        sequence.store(current + 2, memory_order_release);
+    }
+
+    T* snapshot(int thread_id) {
+        Query query = {NULL, 0, capacity};
+        snapshotInto(thread_id, query, states[thread_id].result);
+        return states[thread_id].result;
+    }
+
+    T* snapshot(int thread_id, const vector<int>& indices) {
+        Query query = {indices.data(), 0, (int)indices.size()};
+        snapshotInto(thread_id, query, states[thread_id].result);
+        return states[thread_id].result;
+    }
+
+    T* snapshot(int thread_id, int first, int count) {
+        Query query = {NULL, first, count};
+        snapshotInto(thread_id, query, states[thread_id].result);
+        return states[thread_id].result;
+    }
+};
+
+// baseline snapshot which keeps registers in an immutable array behind an atomic pointer
+// update copies the current array, changes one location and installs the copy with
+// compare and swap (repeating the copy if another update won), snapshot just copies
+// the current array, old arrays are reused with epoch based reclamation as in MRMW_WFSnapshot
+template <class T>
+class RCUSnapshot {
+    atomic<T*> current;
+    vector<BaselineThreadState<T>> states;
+    atomic<unsigned long> global_epoch;
+
+    void enterEpoch(int thread_id) {
+        states[thread_id].epoch.store(global_epoch.load());
+    }
+
+    void exitEpoch(int thread_id) {
+        states[thread_id].epoch.store(QUIESCENT);
+    }
+
+    unsigned long minActiveEpoch() {
+        unsigned long min_epoch = QUIESCENT;
+        for(size_t i=0;i<states.size();i++)
+            min_epoch = min(min_epoch, states[i].epoch.load());
+        return min_epoch;
+    }
+
+    // array for next version of registers, reusing a retired one if it is safe
+    T* allocateArray(BaselineThreadState<T>& state) {
+        if(state.retired_head < state.retired.size()
+            && state.retired[state.retired_head].first < minActiveEpoch()) {
+            T* array = state.retired[state.retired_head].second;
+            state.retired_head++;
+            if(state.retired_head == state.retired.size()) {
+                state.retired.clear();
+                state.retired_head = 0;
+            }
+            return array;
+        }
+        return new T[capacity];
+    }
+
+    T* snapshotQuery(int thread_id, const Query& query) {
+        T* result = states[thread_id].result;
+        enterEpoch(thread_id);
+        T* array = current.load();
+        for(int k=0;k<query.count;k++)
+            result[k] = array[query.location(k)];
+        exitEpoch(thread_id);
+        return result;
+    }
+
+public:
+    RCUSnapshot(T init, int n_scanners) : states(n_threads + n_scanners) {
+        T* array = new T[capacity];
+        fill(array, array + capacity, init);
+        current.store(array);
+        global_epoch.store(0);
+    }
+
+    int retries(int thread_id) {
+        return states[thread_id].retries;
+    }
+
+    void update(int thread_id, int location, T value) {
+        BaselineThreadState<T>& state = states[thread_id];
+        T* array = allocateArray(state);
+        state.retries = 0;
+        enterEpoch(thread_id);
+        T* old_array = current.load();
+        while(true) {
+            copy(old_array, old_array + capacity, array);
+            array[location] = value;
+            if(current.compare_exchange_strong(old_array, array))
+                break;
+            state.retries++;
+        }
+        exitEpoch(thread_id);
+        // snapshots entering after this increment cannot read old array
+        unsigned long epoch = global_epoch.fetch_add(1);
+        state.retired.push_back(make_pair(epoch, old_array));
+    }
+
+    T* snapshot(int thread_id) {
+        Query query = {NULL, 0, capacity};
+        return snapshotQuery(thread_id, query);
+    }
+
+    T* snapshot(int thread_id, const vector<int>& indices) {
+        Query query = {indices.data(), 0, (int)indices.size()};
+        return snapshotQuery(thread_id, query);
+    }
+
+    T* snapshot(int thread_id, int first, int count) {
+        Query query = {NULL, first, count};
+        return snapshotQuery(thread_id, query);
+    }
+
+    ~RCUSnapshot() {
+        delete[] current.load();
     }
 };
 
-// declare mrmw wait free snapshot object of size capacity
-MRMW_WFSnapshot<int>* MRMW_snap_object;
+// kind of logged event
+const int WRITE_EVENT = 0;
+const int SNAPSHOT_EVENT = 1;
+
+// fixed size binary record of a write or a snapshot, turned into text only
+// when the output file is written
+class Event {
+public:
+    // microseconds since start, used to merge logs of all threads
+    long time;
+    int kind;
+    // writer thread id or snapshot thread id
+    int thread_id;
+    // written value of write event
+    int value;
+    // location written by write event
+    int location;
+    // snapshot event keeps its registers at values_offset in snapshot_values of its log
+    long values_offset;
+};
+
+// log of one thread, only touched by that thread until it finishes
+// buffers are reserved up front so that logging does not allocate while thread runs
+class EventLog {
+public:
+    vector<Event> events;
+    // for every snapshot event, queried locations (partial snapshot only) followed by values
+    vector<int> snapshot_values;
+
+    void reserve(size_t n_events, size_t n_values) {
+        events.clear();
+        snapshot_values.clear();
+        events.reserve(n_events);
+        snapshot_values.reserve(n_values);
+    }
+};
+
+// logs of writer threads and snapshot threads
+vector<EventLog> writer_logs;
+vector<EventLog> snapshot_logs;
+// wall clock time of start, event times are offsets from it in microseconds
+chrono::system_clock::time_point start_wall_time;
+
+// number of registers logged by a snapshot
+int snapshotSize() {
+    return query_size > 0 ? query_size : capacity;
+}
+
+// renders event as a line of text in the format of the log
+void renderEvent(ostream& out, const Event& event, const EventLog& log) {
+    time_t event_time_t = chrono::system_clock::to_time_t(start_wall_time + chrono::microseconds(event.time));
+    tm* event_time = localtime(&event_time_t);
+    if(event.kind == WRITE_EVENT) {
+        out<<"Thr"<<event.thread_id<<"'s write of "<<event.value<<" on location "<<event.location<<" at "<<event_time->tm_hour<<":"<<event_time->tm_min<<":"<<event_time->tm_sec<<"\n";
+        return;
+    }
+    out<<"Snapshot Thr"<<event.thread_id<<"'s snapshot: ";
+    const int* values = log.snapshot_values.data() + event.values_offset;
+    if(query_size > 0) {
+        for(int i=0;i<query_size;i++)
+            out<<"l"<<values[i]<<"-"<<values[query_size + i]<<" ";
+    } else {
+        for(int i=0;i<capacity;i++)
+            out<<"l"<<i<<"-"<<values[i]<<" ";
+    }
+    out<<" which finished at "<<event_time->tm_hour<<":"<<event_time->tm_min<<":"<<event_time->tm_sec<<"\n";
+}
 
-// map containing writer thread events 
-// key is time and value is long entry of type string
-map<double, string> write_events;
+// merges logs of all threads by time and renders them onto output file
+// every log is already sorted, so a k-way merge with a heap of the next event of each log
+// is enough, events with equal times are all kept
+void writeEvents() {
+    vector<const EventLog*> logs;
+    for(auto& log:writer_logs)
+        logs.push_back(&log);
+    for(auto& log:snapshot_logs)
+        logs.push_back(&log);
+    // heap of (time, log, position of event in log), smallest time on top
+    typedef tuple<long, size_t, size_t> HeapEntry;
+    priority_queue<HeapEntry, vector<HeapEntry>, greater<HeapEntry>> heap;
+    for(size_t i=0;i<logs.size();i++)
+        if(!logs[i]->events.empty())
+            heap.push(make_tuple(logs[i]->events[0].time, i, 0));
+    while(!heap.empty()) {
+        size_t log_index = get<1>(heap.top());
+        size_t position = get<2>(heap.top());
+        heap.pop();
+        const EventLog& log = *logs[log_index];
+        renderEvent(output_file, log.events[position], log);
+        if(position + 1 < log.events.size())
+            heap.push(make_tuple(log.events[position + 1].time, log_index, position + 1));
+    }
+}
 
-void writer(int thread_id) {
+// writer thread
+template <class S>
+void writer(S* MRMW_snap_object, int thread_id) {
     //srand(time(NULL));
-    map<double, string> local_write_events;
-    // stamp number for each thread
-    int stamp = 0;
+    EventLog& log = writer_logs[thread_id];
     // exponential_distribution for delay
     exponential_distribution<double> exponential_1((double)1/(double)lambda_1);
-    while(!terminate_writer_thread) {
-        stringstream local_output;
+    // number of writes done by this thread
+    long writes = 0;
+    auto begin_time = chrono::high_resolution_clock::now();
+    while(n_writes > 0 ? writes < n_writes : !terminate_writer_thread) {
         int value = rand();
         int location = rand() % capacity;
-        MRMW_snap_object->update(thread_id, location, value, stamp);
+        MRMW_snap_object->update(thread_id, location, value);
         auto enter_time = chrono::high_resolution_clock::now(); 
-        time_t entry_time_t = time(0);
-        tm* entry_time = localtime(&entry_time_t);
-        local_output<<"Thr"<<thread_id<<"'s write of "<<value<<" on location "<<location<<" at "<<entry_time->tm_hour<<":"<<entry_time->tm_min<<":"<<entry_time->tm_sec<<"\n";
-        double time_taken = chrono::duration_cast<chrono::microseconds>(enter_time - start).count();
-        // time in seconds
-        time_taken /= 1000000;
-        // storing write event onto local events map
-        local_write_events[time_taken] = local_output.str();
-        //record system time and value v in local log
+        // record time and value in local log, text is rendered after threads finish
+        Event event;
+        event.time = chrono::duration_cast<chrono::microseconds>(enter_time - start).count();
+        event.kind = WRITE_EVENT;
+        event.thread_id = thread_id;
+        event.value = value;
+        event.location = location;
+        event.values_offset = 0;
+        log.events.push_back(event);
         sleep(exponential_1(generator));
-        // incrementing stamp for current thread
-        stamp++;
+        writes++;
     }
-
-    // using lock for writing events into map, since multiple threads can write onto map
-    // and to guarantee safety, used lock although it won't affect output result times
-    output_file_lock.lock();
-    for(auto event:local_write_events)
-        write_events[event.first] = event.second;
-    output_file_lock.unlock();
-    //output_file<<local_output.rdbuf();
+    double duration = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - begin_time).count()/(double)1000000;
+    writer_throughput[thread_id] = writes/duration;
 }
 
-void snapshot() {
+
+// snapshot thread, scanner_id ranges from 0 to n_scanners-1
+template <class S>
+void snapshot(S* MRMW_snap_object, int scanner_id) {
+    // snapshot threads use the thread ids after writers
+    int thread_id = n_threads + scanner_id;
+    EventLog& log = snapshot_logs[scanner_id];
     // count of snapshots
     int count = 0;
-    // local map for log entries
-    map<double, string> local_write_events;
+    // snapshot times and retries of this thread
+    double local_completion_time = 0, local_worst_case_time = 0;
+    Histogram local_scan_time_histogram, local_retry_histogram;
+    vector<double> local_scan_times;
+    local_scan_times.reserve(n_snapshots);
+    auto begin_time = chrono::high_resolution_clock::now();
     // exponential_distribution for delay
     exponential_distribution<double> exponential_2((double)1/(double)lambda_2);
+    // registers read by a partial snapshot
+    vector<int> query(query_size);
     while(count < n_snapshots) {
-        // thread local string stream
-        stringstream local_output;
+        // choosing registers of partial snapshot
+        for(int i=0;i<query_size;i++)
+            query[i] = rand() % capacity;
         // begin collect time
         auto high_res_begin_collect_time = chrono::high_resolution_clock::now();
-        time_t begin_collect_time_t = time(0);
-        tm* begin_collect_time = localtime(&begin_collect_time_t);
         
-        // call snapshot 
-        int* collect = MRMW_snap_object->snapshot();
+        // call snapshot
+        int* collect = query_size > 0 ? MRMW_snap_object->snapshot(thread_id, query) : MRMW_snap_object->snapshot(thread_id);
         
         // end collect time
         auto high_res_end_collect_time = chrono::high_resolution_clock::now();
-        time_t end_collect_time_t = time(0);
-        tm* end_collect_time = localtime(&end_collect_time_t);
 
         // time taken to collect snapshot
         double time_taken = chrono::duration_cast<chrono::microseconds>(high_res_end_collect_time - high_res_begin_collect_time).count();
-        avg_completion_time += time_taken;
-        worst_case_time = max(worst_case_time, time_taken);
+        local_completion_time += time_taken;
+        local_worst_case_time = max(local_worst_case_time, time_taken);
+        local_scan_time_histogram.add((long)time_taken);
+        local_retry_histogram.add(MRMW_snap_object->retries(thread_id));
+        local_scan_times.push_back(time_taken);
 
-        local_output<<"Snapshot Thr's snapshot: ";
-        for(int i=0;i<capacity;i++)
-            local_output<<"l"<<i<<"-"<<collect[i]<<" ";
-        local_output<<" which finished at "<<end_collect_time->tm_hour<<":"<<end_collect_time->tm_min<<":"<<end_collect_time->tm_sec<<"\n";
-
-        double time_diff = chrono::duration_cast<chrono::microseconds>(high_res_end_collect_time - start).count();
-        // time in seconds
-        time_diff /= 1000000;
-        // storing write event onto local events map
-        local_write_events[time_diff] = local_output.str();
-
-        //delete[] collect;
+        // copying snapshot into local log, collect is owned by snapshot object and reused by next snapshot
+        Event event;
+        event.time = chrono::duration_cast<chrono::microseconds>(high_res_end_collect_time - start).count();
+        event.kind = SNAPSHOT_EVENT;
+        event.thread_id = scanner_id;
+        event.values_offset = log.snapshot_values.size();
+        log.snapshot_values.insert(log.snapshot_values.end(), query.begin(), query.end());
+        log.snapshot_values.insert(log.snapshot_values.end(), collect, collect + snapshotSize());
+        log.events.push_back(event);
 
         sleep(exponential_2(generator));
         count++;
     }
+    double duration = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - begin_time).count()/(double)1000000;
+    scanner_throughput[scanner_id] = count/duration;
 
-    // using lock for writing events into map, since multiple threads can write onto map
-    // and to guarantee safety, used lock although it won't affect output result times
+    // merging statistics of this thread, lock is needed since multiple snapshot threads merge
     output_file_lock.lock();
-    for(auto event:local_write_events)
-        write_events[event.first] = event.second;
+    avg_completion_time += local_completion_time;
+    worst_case_time = max(worst_case_time, local_worst_case_time);
+    scan_time_histogram.merge(local_scan_time_histogram);
+    retry_histogram.merge(local_retry_histogram);
+    scan_times.insert(scan_times.end(), local_scan_times.begin(), local_scan_times.end());
     output_file_lock.unlock();
 }
 
-int main() {
-    // seed for default random engine generator
-    generator.seed(4);
-    
-    // input file stream
-    ifstream input_file;
-    input_file.open("inp-params.txt");
-    
-    // output file stream
-    output_file.open("output.txt");
-
-    // lambda_1 is average delay for writer thread and lambda_2 is average delay for snapshot thread
-    input_file >> n_threads >> capacity >> lambda_1 >> lambda_2 >> n_snapshots;
-
-    // instantiating MRMW Snapshot object
-    MRMW_snap_object = new MRMW_WFSnapshot<int>(0);
-
+// runs writer threads and snapshot threads on given snapshot object,
+// writes their logs onto output file and prints snapshot times
+template <class S>
+void runSnapshotTest(string name, S* MRMW_snap_object) {
     // writer threads
     thread writer_threads[n_threads];
-    // one snapshot thread
-    thread snapshot_thread;
+    // snapshot threads
+    thread snapshot_threads[n_scanners];
     
+    terminate_writer_thread = false;
     start = chrono::high_resolution_clock::now();
+    start_wall_time = chrono::system_clock::now();
     avg_completion_time = 0.0;
     worst_case_time = 0;
+    scan_time_histogram = Histogram();
+    retry_histogram = Histogram();
+    scan_times.clear();
+    writer_throughput.assign(n_threads, 0);
+    scanner_throughput.assign(n_scanners, 0);
+    // preallocating logs, a writer running until snapshot threads finish starts
+    // with room for the average number of writes and grows if it needs more
+    writer_logs.resize(n_threads);
+    for(int i=0;i<n_threads;i++)
+        writer_logs[i].reserve(n_writes > 0 ? n_writes : n_snapshots, 0);
+    snapshot_logs.resize(n_scanners);
+    for(int i=0;i<n_scanners;i++)
+        snapshot_logs[i].reserve(n_snapshots, (size_t)n_snapshots*(query_size + snapshotSize()));
 
     // creating writer threads
     for(int i=0;i<n_threads;i++)
-        writer_threads[i] = thread(writer, i);
+        writer_threads[i] = thread(writer<S>, MRMW_snap_object, i);
 
-    // creating snapshot thread
-    snapshot_thread = thread(snapshot);
+    // creating snapshot threads
+    for(int i=0;i<n_scanners;i++)
+        snapshot_threads[i] = thread(snapshot<S>, MRMW_snap_object, i);
 
-    // wait until snapshot thread terminates;
-    snapshot_thread.join();
+    // wait until snapshot threads terminate;
+    for(int i=0;i<n_scanners;i++)
+        snapshot_threads[i].join();
 
     // inform writer threads that they have to terminate
     terminate_writer_thread = true;
@@ -327,15 +1268,414 @@ int main() {
         writer_threads[i].join();
 
     // write all log entries onto file
-    // Log entries are sorted by their time of entry
-    for(auto event:write_events) {
-        output_file<<event.second;
-    }
-    write_events.clear();
+    // Log entries are merged by their time of entry
+    writeEvents();
 
-    avg_completion_time /= n_snapshots;
+    avg_completion_time /= (double)n_snapshots*n_scanners;
+    cout<<name<<endl;
     cout<<"Average waiting time for taking snapshot is "<<avg_completion_time<<endl;
     cout<<"Worst case time to take snapshot is "<<worst_case_time<<endl;
+    for(int i=0;i<n_threads;i++)
+        cout<<"Writer thread "<<i<<" throughput (writes per second): "<<writer_throughput[i]<<endl;
+    for(int i=0;i<n_scanners;i++)
+        cout<<"Snapshot thread "<<i<<" throughput (snapshots per second): "<<scanner_throughput[i]<<endl;
+    scan_time_histogram.print("Histogram of snapshot times (in microseconds)");
+    retry_histogram.print("Histogram of repeated collects per snapshot");
+
+    sort(scan_times.begin(), scan_times.end());
+    BenchmarkResult result;
+    result.name = name;
+    result.writes_per_second = 0;
+    for(int i=0;i<n_threads;i++)
+        result.writes_per_second += writer_throughput[i];
+    result.snapshots_per_second = 0;
+    for(int i=0;i<n_scanners;i++)
+        result.snapshots_per_second += scanner_throughput[i];
+    result.avg_time = avg_completion_time;
+    result.p50_time = scan_times[scan_times.size()/2];
+    result.p99_time = scan_times[scan_times.size()*99/100];
+    result.worst_time = worst_case_time;
+    benchmark_results.push_back(result);
+}
+
+// prints results of all snapshot objects side by side
+void printComparison() {
+    cout<<"\nComparison (writes and snapshots per second summed over threads, snapshot times in microseconds)"<<endl;
+    cout<<left<<setw(40)<<"Snapshot object"<<right<<setw(14)<<"writes/s"<<setw(14)<<"snapshots/s"
+        <<setw(12)<<"avg"<<setw(12)<<"p50"<<setw(12)<<"p99"<<setw(12)<<"max"<<endl;
+    for(auto& result:benchmark_results) {
+        cout<<left<<setw(40)<<result.name<<right<<fixed<<setprecision(0)
+            <<setw(14)<<result.writes_per_second<<setw(14)<<result.snapshots_per_second
+            <<setprecision(2)<<setw(12)<<result.avg_time<<setw(12)<<result.p50_time
+            <<setw(12)<<result.p99_time<<setw(12)<<result.worst_time<<endl;
+        cout.unsetf(ios::fixed);
+        cout<<setprecision(6);
+    }
+}
+
+// record of SIZE bytes used to benchmark large values, every field holds the
+// same number so that a torn read of a record can be detected
+template <int SIZE>
+class Record {
+public:
+    int fields[SIZE/sizeof(int)];
+
+    Record() : Record(0) {}
+
+    Record(int value) {
+        fill(fields, fields + SIZE/sizeof(int), value);
+    }
+
+    bool consistent() const {
+        for(size_t i=1;i<SIZE/sizeof(int);i++)
+            if(fields[i] != fields[0])
+                return false;
+        return true;
+    }
+};
+
+// runs writers and one snapshot thread on records of given register layout without
+// logging, and prints throughput, snapshot time and number of torn records seen
+template <class T, class R>
+void payloadBenchmark(string name) {
+    MRMW_WFSnapshot<T, R>* snap_object = new MRMW_WFSnapshot<T, R>(T(), 1);
+    long writes = n_writes > 0 ? n_writes : 10000;
+    atomic<int> running_writers(n_threads);
+    thread writer_threads[n_threads];
+    auto begin_time = chrono::high_resolution_clock::now();
+    for(int i=0;i<n_threads;i++) {
+        writer_threads[i] = thread([=, &running_writers]() {
+            for(long k=0;k<writes;k++)
+                snap_object->update(i, (i + k*7919) % capacity, T((int)k));
+            running_writers--;
+        });
+    }
+    // snapshot thread, runs while writers are running
+    long snapshots = 0, torn = 0;
+    double snapshot_time = 0;
+    while(running_writers.load() > 0) {
+        auto begin_snapshot = chrono::high_resolution_clock::now();
+        T* collect = snap_object->snapshot(n_threads);
+        snapshot_time += chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - begin_snapshot).count();
+        for(int i=0;i<capacity;i++)
+            if(!collect[i].consistent())
+                torn++;
+        snapshots++;
+    }
+    for(int i=0;i<n_threads;i++)
+        writer_threads[i].join();
+    double duration = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - begin_time).count()/(double)1000000;
+    cout<<left<<setw(45)<<name<<right<<fixed<<setprecision(0)
+        <<setw(14)<<n_threads*writes/duration<<setw(14)<<snapshots/duration
+        <<setprecision(2)<<setw(12)<<(snapshots > 0 ? snapshot_time/snapshots/1000 : 0)<<setw(8)<<torn<<endl;
+    cout.unsetf(ios::fixed);
+    cout<<setprecision(6);
+    delete snap_object;
+}
+
+// compares values stored inline in the register (guarded by libatomic lock) with
+// values stored in pooled nodes behind an atomic pointer, for several record sizes
+template <int SIZE>
+void payloadBenchmarks() {
+    payloadBenchmark<Record<SIZE>, StampedReg<Record<SIZE>>>("Inline " + to_string(SIZE) + " byte records");
+    payloadBenchmark<Record<SIZE>, IndirectStampedReg<Record<SIZE>>>("Indirect " + to_string(SIZE) + " byte records");
+}
+
+// writers write the two values 0 and 1 in turn (ABA pattern) while the snapshot thread
+// reads single registers twice and checks that tags changed whenever a write must have
+// happened between the two reads, and takes full snapshots to watch their retries
+// a write must have happened if more updates of the register finished before the second
+// read than had started after the first read
+// registers start at version first_stamp
+template <class R>
+void stressTest(string name, long updates, long first_stamp = 0) {
+    MRMW_WFSnapshot<int, R>* snap_object = new MRMW_WFSnapshot<int, R>(0, 1, first_stamp);
+    vector<atomic<long>> started(capacity), finished(capacity);
+    for(int i=0;i<capacity;i++) {
+        started[i].store(0);
+        finished[i].store(0);
+    }
+    atomic<int> running_writers(n_threads);
+    thread writer_threads[n_threads];
+    auto begin_time = chrono::high_resolution_clock::now();
+    for(int i=0;i<n_threads;i++) {
+        writer_threads[i] = thread([=, &started, &finished, &running_writers]() {
+            for(long k=0;k<updates;k++) {
+                int location = (i + k*7919) % capacity;
+                started[location]++;
+                snap_object->update(i, location, (int)(k & 1));
+                finished[location]++;
+            }
+            running_writers--;
+        });
+    }
+    // snapshot thread
+    int thread_id = n_threads;
+    uint64_t tags[2];
+    int values[2];
+    CollectBuffer<int> first_read = {&tags[0], &values[0]}, second_read = {&tags[1], &values[1]};
+    long checks = 0, changed_checks = 0, missed = 0, snapshots = 0, total_retries = 0;
+    int max_retries = 0;
+    while(running_writers.load() > 0) {
+        for(int location=0;location<capacity;location++) {
+            Query query = {NULL, location, 1};
+            snap_object->collect(thread_id, query, first_read);
+            long started_after_first = started[location].load();
+            // letting writers run between the two reads
+            this_thread::yield();
+            long finished_before_second = finished[location].load();
+            snap_object->collect(thread_id, query, second_read);
+            checks++;
+            if(finished_before_second > started_after_first) {
+                changed_checks++;
+                if(tags[0] == tags[1])
+                    missed++;
+            }
+        }
+        snap_object->snapshot(thread_id);
+        snapshots++;
+        total_retries += snap_object->retries(thread_id);
+        max_retries = max(max_retries, snap_object->retries(thread_id));
+    }
+    for(int i=0;i<n_threads;i++)
+        writer_threads[i].join();
+    double duration = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - begin_time).count()/(double)1000000;
+    cout<<name<<endl;
+    cout<<"Updates: "<<n_threads*updates<<" ("<<n_threads*updates/duration<<" per second)"<<endl;
+    cout<<"Double reads: "<<checks<<", with a write between them: "<<changed_checks<<", missed changes: "<<missed<<endl;
+    cout<<"Snapshots: "<<snapshots<<", average retries: "<<(snapshots > 0 ? (double)total_retries/snapshots : 0)
+        <<", maximum retries: "<<max_retries<<endl;
+    delete snap_object;
+}
+
+// writer i writes 1, 2, 3, ... to register i while the snapshot thread takes snapshots of a
+// query which names the first half of the registers twice each, a long query so that writes
+// often land inside a snapshot. A snapshot is stale if a register is below the last value
+// written before it started or above the last value whose write started before it ended, and
+// inconsistent if the two positions of a register differ
+// registers start at version first_stamp
+template <class R>
+void repeatedQueryTest(string name, long updates, long first_stamp = 0) {
+    MRMW_WFSnapshot<int, R>* snap_object = new MRMW_WFSnapshot<int, R>(0, 1, first_stamp);
+    int m = max(1, capacity/2);
+    vector<int> query;
+    for(int i=0;i<m;i++) {
+        query.push_back(i);
+        query.push_back(i);
+    }
+    int n_writers = min(n_threads, capacity);
+    vector<atomic<int>> started(n_writers), finished(n_writers);
+    for(int i=0;i<n_writers;i++) {
+        started[i].store(0);
+        finished[i].store(0);
+    }
+    atomic<int> running_writers(n_writers);
+    vector<thread> writer_threads;
+    for(int i=0;i<n_writers;i++) {
+        writer_threads.push_back(thread([=, &started, &finished, &running_writers]() {
+            for(int value=1;value<=updates;value++) {
+                started[i].store(value);
+                snap_object->update(i, i, value);
+                finished[i].store(value);
+            }
+            running_writers--;
+        }));
+    }
+    // snapshot thread
+    int thread_id = n_threads;
+    vector<int> lower(m), upper(m);
+    long snapshots = 0, retried = 0, stale = 0, inconsistent = 0;
+    while(running_writers.load() > 0) {
+        for(int i=0;i<m;i++)
+            lower[i] = i < n_writers ? finished[i].load() : 0;
+        int* result = snap_object->snapshot(thread_id, query);
+        for(int i=0;i<m;i++)
+            upper[i] = i < n_writers ? started[i].load() : 0;
+        snapshots++;
+        if(snap_object->retries(thread_id) > 0)
+            retried++;
+        for(int i=0;i<m;i++) {
+            if(result[2*i] != result[2*i + 1])
+                inconsistent++;
+            else if(result[2*i] < lower[i] || result[2*i] > upper[i])
+                stale++;
+        }
+    }
+    for(auto& t:writer_threads)
+        t.join();
+    cout<<name<<endl;
+    cout<<"Repeated index query of "<<query.size()<<" indices over "<<m<<" registers"<<endl;
+    cout<<"Snapshots: "<<snapshots<<", with writers active: "<<retried<<", stale registers: "<<stale
+        <<", inconsistent registers: "<<inconsistent<<endl;
+    delete snap_object;
+}
+
+// packed versions around 2^22, register 0 starts two writes before its version comes round,
+// writer 0 then writes the same value into it 2^22-1 and one more times, the tag must change
+// after the first batch and repeat after the second, which write version must report as a
+// possible repetition. A snapshot of register 0 then has 2^22 writes installed into it between
+// its two collects, so both collects see the same tag, and must borrow a help snapshot instead
+// of returning the second collect. Stress and repeated query tests then run with every register
+// starting 1000 writes before its version comes round, so their writes cross it
+void wrapTest(long updates) {
+    const long first_stamp = PACKED_STAMP_PERIOD - 2;
+    MRMW_WFSnapshot<int, PackedStampedReg<int>>* snap_object = new MRMW_WFSnapshot<int, PackedStampedReg<int>>(0, 1, first_stamp);
+    int thread_id = n_threads;
+    uint64_t tags[3];
+    int values[3];
+    CollectBuffer<int> reads[3] = {{&tags[0], &values[0]}, {&tags[1], &values[1]}, {&tags[2], &values[2]}};
+    Query query = {NULL, 0, 1};
+    snap_object->update(0, 0, 1);
+    unsigned long before = snap_object->writeVersion();
+    snap_object->collect(thread_id, query, reads[0]);
+    for(unsigned long k=0;k<PACKED_STAMP_PERIOD - 1;k++)
+        snap_object->update(0, 0, 1);
+    snap_object->collect(thread_id, query, reads[1]);
+    unsigned long after_batch = snap_object->writeVersion();
+    snap_object->update(0, 0, 1);
+    snap_object->collect(thread_id, query, reads[2]);
+    unsigned long after = snap_object->writeVersion();
+    cout<<"Packed register written 2^22-1 times with the same value: tag "<<(tags[0] != tags[1] ? "changed" : "repeated")
+        <<", possible repetition reported: "<<(MRMW_WFSnapshot<int, PackedStampedReg<int>>::stampsMayRepeat(before, after_batch) ? "yes" : "no")<<endl;
+    cout<<"Packed register written 2^22 times with the same value: tag "<<(tags[0] != tags[2] ? "changed" : "repeated")
+        <<", possible repetition reported: "<<(MRMW_WFSnapshot<int, PackedStampedReg<int>>::stampsMayRepeat(before, after) ? "yes" : "no")<<endl;
+    delete snap_object;
+
+    // writer 0 writes register 0 once before the first collect, so the single collect fast path
+    // is not taken, and 2^22 more values into it before the second collect
+    MRMW_WFSnapshot<int, PackedStampedReg<int>>* wrap_object = new MRMW_WFSnapshot<int, PackedStampedReg<int>>(0, 1);
+    wrap_object->update(0, 0, 1);
+    int collects = 0;
+    wrap_object->before_collect = [&](int collecting_thread) {
+        // snapshots taken by updates of writer 0 run the hook as well
+        if(collecting_thread != thread_id)
+            return;
+        collects++;
+        if(collects == 1)
+            wrap_object->update(0, 0, 1);
+        else if(collects == 2) {
+            wrap_object->collect(query, reads[0]);
+            for(unsigned long k=1;k<=PACKED_STAMP_PERIOD;k++)
+                wrap_object->update(0, 0, (int)k + 1);
+            wrap_object->collect(query, reads[1]);
+        }
+    };
+    int* result = wrap_object->snapshot(thread_id, 0, 1);
+    cout<<"Snapshot with 2^22 writes between its collects: tag "<<(tags[0] != tags[1] ? "changed" : "repeated")
+        <<" while value went from "<<values[0]<<" to "<<values[1]<<", equal tags not trusted: "
+        <<(wrap_object->borrowedOnWrap(thread_id) ? "yes" : "no")<<", snapshot value: "<<result[0]
+        <<" (last written "<<PACKED_STAMP_PERIOD + 1<<")"<<endl;
+    delete wrap_object;
+    stressTest<PackedStampedReg<int>>("Packed register layout, versions starting 1000 writes before 2^22", updates, PACKED_STAMP_PERIOD - 1000);
+    repeatedQueryTest<PackedStampedReg<int>>("Packed register layout, versions starting 1000 writes before 2^22", updates, PACKED_STAMP_PERIOD - 1000);
+}
+
+// packed register holds thread_id+1 in 10 bits, runs of the packed layout are skipped with more writers
+bool packedLayoutFits() {
+    if(n_threads <= MAX_PACKED_WRITERS)
+        return true;
+    cout<<"Packed register layout supports at most "<<MAX_PACKED_WRITERS<<" writer threads, skipping it"<<endl;
+    return false;
+}
+
+int main(int argc, char* argv[]) {
+    // seed for default random engine generator
+    generator.seed(4);
+    
+    // input file stream
+    ifstream input_file;
+    input_file.open("inp-params.txt");
+    
+    // output file stream
+    output_file.open("output.txt");
+
+    // lambda_1 is average delay for writer thread and lambda_2 is average delay for snapshot thread
+    input_file >> n_threads >> capacity >> lambda_1 >> lambda_2 >> n_snapshots;
+    // optional size of partial snapshot
+    if(!(input_file >> query_size))
+        query_size = 0;
+    query_size = min(query_size, capacity);
+    // optional number of snapshot threads and number of writes by each writer
+    if(!(input_file >> n_scanners))
+        n_scanners = 1;
+    if(!(input_file >> n_writes))
+        n_writes = 0;
+
+    // writer ids have to fit into tags of collected registers
+    if(n_threads > MAX_WRITERS) {
+        cout<<"At most "<<MAX_WRITERS<<" writer threads are supported"<<endl;
+        return 1;
+    }
+
+    // ./mrmw payload compares register layouts for large values instead of running the log test
+    if(argc > 1 && string(argv[1]) == "payload") {
+        cout<<"Payload benchmark (snapshot time in microseconds, torn is number of inconsistent records seen)"<<endl;
+        cout<<left<<setw(45)<<"Register layout"<<right<<setw(14)<<"writes/s"<<setw(14)<<"snapshots/s"
+            <<setw(12)<<"avg"<<setw(8)<<"torn"<<endl;
+        payloadBenchmarks<16>();
+        payloadBenchmarks<64>();
+        payloadBenchmarks<128>();
+        payloadBenchmarks<256>();
+        return 0;
+    }
+
+    // ./mrmw stress [updates] runs stress test of register versions with given updates per writer
+    if(argc > 1 && string(argv[1]) == "stress") {
+        long updates = argc > 2 ? atol(argv[2]) : 1000000;
+        if(packedLayoutFits())
+            stressTest<PackedStampedReg<int>>("Packed register layout (lock free)", updates);
+        stressTest<StampedReg<int>>("Locked register layout (libatomic)", updates);
+        stressTest<IndirectStampedReg<int>>("Indirect register layout", updates);
+        return 0;
+    }
+
+    // ./mrmw wrap [updates] checks packed registers whose versions come round past 2^22
+    if(argc > 1 && string(argv[1]) == "wrap") {
+        if(packedLayoutFits())
+            wrapTest(argc > 2 ? atol(argv[2]) : 1000000);
+        return 0;
+    }
+
+    // ./mrmw repeat [updates] checks snapshots of a query repeating every index while writers run
+    if(argc > 1 && string(argv[1]) == "repeat") {
+        long updates = argc > 2 ? atol(argv[2]) : 1000000;
+        if(packedLayoutFits())
+            repeatedQueryTest<PackedStampedReg<int>>("Packed register layout (lock free)", updates);
+        repeatedQueryTest<IndirectStampedReg<int>>("Indirect register layout", updates);
+        return 0;
+    }
+
+    // lock free packed register layout
+    if(packedLayoutFits()) {
+        output_file<<"Packed register layout:\n";
+        MRMW_WFSnapshot<int, PackedStampedReg<int>>* packed_snap_object = new MRMW_WFSnapshot<int, PackedStampedReg<int>>(0, n_scanners);
+        runSnapshotTest("Packed register layout (lock free)", packed_snap_object);
+        delete packed_snap_object;
+    }
+
+    // register layout guarded by libatomic lock
+    output_file<<"\nLocked register layout:\n";
+    MRMW_WFSnapshot<int, StampedReg<int>>* locked_snap_object = new MRMW_WFSnapshot<int, StampedReg<int>>(0, n_scanners);
+    runSnapshotTest("Locked register layout (libatomic)", locked_snap_object);
+    delete locked_snap_object;
+
+    // coarse grained baselines with the same interface
+    output_file<<"\nShared mutex baseline:\n";
+    LockedSnapshot<int>* mutex_snap_object = new LockedSnapshot<int>(0, n_scanners);
+    runSnapshotTest("Shared mutex baseline", mutex_snap_object);
+    delete mutex_snap_object;
+
+    output_file<<"\nSeqlock baseline:\n";
+    SeqlockSnapshot<int>* seqlock_snap_object = new SeqlockSnapshot<int>(0, n_scanners);
+    runSnapshotTest("Seqlock baseline", seqlock_snap_object);
+    delete seqlock_snap_object;
+
+    output_file<<"\nRCU copy on write baseline:\n";
+    RCUSnapshot<int>* rcu_snap_object = new RCUSnapshot<int>(0, n_scanners);
+    runSnapshotTest("RCU copy on write baseline", rcu_snap_object);
+    delete rcu_snap_object;
+
+    printComparison();
 
     // cleanup i.e. closing all the files
     input_file.close();
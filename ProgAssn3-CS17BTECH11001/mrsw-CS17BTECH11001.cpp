@@ -8,8 +8,9 @@
 #include <unistd.h>
 #include <random>
 #include <atomic>
-#include <sstream>
-#include <map>
+#include <iomanip>
+#include <queue>
+#include <tuple>
 #include <vector>
 #include <algorithm>
 using namespace std;
@@ -22,6 +23,12 @@ ofstream output_file;
 
 // parameters of input file
 int n_threads, capacity, n_snapshots;
+// number of registers read by each snapshot, 0 reads all of them
+int query_size;
+// number of snapshot threads
+int n_scanners;
+// number of writes by each writer thread, 0 runs writers until snapshot threads finish
+long n_writes;
 double lambda_1, lambda_2;
 
 // mutex lock for output file writing
@@ -39,6 +46,62 @@ double avg_completion_time;
 // worst case time for snapshot
 double worst_case_time;
 
+// histogram with power of two buckets, bucket 0 counts zeros and
+// bucket b counts values in [2^(b-1), 2^b)
+class Histogram {
+    vector<long> buckets;
+public:
+    Histogram() : buckets(64, 0) {}
+
+    // counting given value in its bucket
+    void add(long value) {
+        int bucket = value <= 0 ? 0 : 64 - __builtin_clzl(value);
+        buckets[bucket]++;
+    }
+
+    // adding counts of other histogram
+    void merge(const Histogram& other) {
+        for(size_t i=0;i<buckets.size();i++)
+            buckets[i] += other.buckets[i];
+    }
+
+    // printing non empty buckets
+    void print(string name) {
+        cout<<name<<endl;
+        for(size_t i=0;i<buckets.size();i++) {
+            if(buckets[i] == 0)
+                continue;
+            if(i == 0)
+                cout<<"  0: "<<buckets[i]<<endl;
+            else
+                cout<<"  ["<<(1L << (i-1))<<", "<<(1L << i)<<"): "<<buckets[i]<<endl;
+        }
+    }
+};
+
+// histogram of snapshot times in microseconds
+Histogram scan_time_histogram;
+// histogram of collects repeated by a snapshot after its first collect
+Histogram retry_histogram;
+// operations per second of each writer thread and each snapshot thread
+vector<double> writer_throughput;
+vector<double> scanner_throughput;
+// snapshot times in microseconds of all snapshot threads, used for percentiles
+vector<double> scan_times;
+
+// results of one snapshot object, printed side by side after all objects have run
+class BenchmarkResult {
+public:
+    string name;
+    double writes_per_second;
+    double snapshots_per_second;
+    double avg_time;
+    double p50_time;
+    double p99_time;
+    double worst_time;
+};
+vector<BenchmarkResult> benchmark_results;
+
 // Stamped Snap class
 template <class T>
 class Stamped_Snap {
@@ -79,223 +142,758 @@ public:
 };
 
 
+// epoch announced by a thread which is not inside scan
+const unsigned long QUIESCENT = ~0UL;
+
+// write version masks, writes in progress are bounded by number of writers
+// and can't overflow into completed writes
+const unsigned long WRITES_IN_PROGRESS = 0xffffffffUL;
+const unsigned long COMPLETED_WRITE = 1UL << 32;
+
+// subset of registers read by a scan, either count registers starting at first
+// or count registers at given indices
+class Query {
+public:
+    const int* indices;
+    int first;
+    int count;
+
+    // register read at position k of query
+    int location(int k) const {
+        return indices != NULL ? indices[k] : first + k;
+    }
+};
+
+// state of each thread using the snapshot object, preallocated for every thread id
+// so that scan and update do not allocate once the object is warmed up
+template <class T>
+class ThreadState {
+public:
+    // epoch announced while thread is inside scan, QUIESCENT otherwise
+    atomic<unsigned long> epoch;
+    // buffers for the two most recent collects
+    Stamped_Snap<T>* old_copy;
+    Stamped_Snap<T>* new_copy;
+    // marks registers whose writer has been seen moving once
+    bool* moved;
+    // result of most recent scan returned to the caller
+    T* result;
+    // distinct registers of an index query, position of every register among them
+    // (-1 if not in the query) and position of the k-th index among them
+    int* distinct;
+    int* position;
+    int* slot;
+    // collects repeated after the first one by most recent scan
+    int retries;
+    // snap arrays retired by this writer along with the epoch of retirement,
+    // used as a ring starting at retired_head
+    vector<pair<unsigned long, T*>> retired;
+    size_t retired_head;
+    // padding to keep epochs of different threads on different cache lines
+    char padding[64];
+
+    ThreadState() {
+        epoch.store(QUIESCENT);
+        old_copy = new Stamped_Snap<T>[capacity];
+        new_copy = new Stamped_Snap<T>[capacity];
+        moved = new bool[capacity];
+        result = new T[capacity];
+        distinct = new int[capacity];
+        position = new int[capacity];
+        slot = new int[capacity];
+        fill(position, position + capacity, -1);
+        retries = 0;
+        retired_head = 0;
+    }
+
+    ~ThreadState() {
+        delete[] old_copy;
+        delete[] new_copy;
+        delete[] moved;
+        delete[] result;
+        delete[] distinct;
+        delete[] position;
+        delete[] slot;
+        for(size_t i=retired_head;i<retired.size();i++)
+            delete[] retired[i].second;
+    }
+};
+
 // MRSW wait free snapshot class
+// snap arrays embedded in registers are reclaimed with epoch based reclamation,
+// a writer reuses its old snap array once no scan which might have read it is running
 template <class T>
 class MRSW_WFSnapshot {
     vector<StampedSnap<T>> a_table;
-public:
-    MRSW_WFSnapshot() {}
+    // writers use thread ids 0 to n_threads-1, scanners use the ids after them
+    vector<ThreadState<T>> states;
+    // global epoch advanced on every retirement of a snap array
+    atomic<unsigned long> global_epoch;
+    // version of a_table, lower 32 bits count writes in progress and
+    // upper 32 bits count completed writes
+    atomic<unsigned long> write_version;
 
-    MRSW_WFSnapshot(T init) {
-        for(int i=0;i<capacity;i++) {
-            a_table.push_back(StampedSnap<T>(0, init, NULL));
-        }
+    // announcing the epoch in which thread starts reading snap arrays
+    void enterEpoch(int thread_id) {
+        states[thread_id].epoch.store(global_epoch.load());
     }
-    
-    // collection of a_table array
-    StampedSnap<T>* collect() {
-        StampedSnap<T>* copy = new StampedSnap<T>[capacity];
-        for(int j=0;j<capacity;j++) {
-            copy[j] = this->a_table[j];
+
+    // announcing that thread holds no reference to snap arrays
+    void exitEpoch(int thread_id) {
+        states[thread_id].epoch.store(QUIESCENT);
+    }
+
+    // oldest epoch announced by any thread inside scan
+    unsigned long minActiveEpoch() {
+        unsigned long min_epoch = QUIESCENT;
+        for(size_t i=0;i<states.size();i++)
+            min_epoch = min(min_epoch, states[i].epoch.load());
+        return min_epoch;
+    }
+
+    // snap array for next update of writer, reusing a retired one if it is safe
+    T* allocateSnap(ThreadState<T>& state) {
+        if(state.retired_head < state.retired.size()
+            && state.retired[state.retired_head].first < minActiveEpoch()) {
+            T* snap = state.retired[state.retired_head].second;
+            state.retired_head++;
+            // ring is empty, restarting it without releasing its memory
+            if(state.retired_head == state.retired.size()) {
+                state.retired.clear();
+                state.retired_head = 0;
+            }
+            return snap;
         }
-        return copy;
+        return new T[capacity];
     }
-    
-    // snapshot 
-    T* scan() {
-        // boolean array to indicate if thread has updated twice 
-        bool moved[capacity] = {false};
+
+    // retiring snap array which is no longer reachable from a_table
+    void retireSnap(ThreadState<T>& state, T* snap) {
+        // scans entering after this increment cannot read snap
+        unsigned long epoch = global_epoch.fetch_add(1);
+        state.retired.push_back(make_pair(epoch, snap));
+    }
+
+    // snapshot of registers in query into given array, thread must be inside an epoch
+    // only queried registers are collected, so cost scales with query size
+    void scanInto(int thread_id, const Query& query, T* result) {
+        ThreadState<T>& state = states[thread_id];
+        Stamped_Snap<T>* old_copy = state.old_copy;
+        Stamped_Snap<T>* new_copy = state.new_copy;
+        // fast path, a single collect is a snapshot if no write was in progress
+        // before it and no write started until it finished
+        unsigned long version = write_version.load();
+        state.retries = 0;
         // old snapshot
-        StampedSnap<T>* old_copy = collect();
-        bool clean_double_collect = true;
+        collect(query, old_copy);
+        if((version & WRITES_IN_PROGRESS) == 0 && write_version.load() == version) {
+            for(int k=0;k<query.count;k++)
+                result[k] = old_copy[k].value;
+            return;
+        }
+        // writers are active, falling back to double collect with helping
+        // boolean array to indicate if thread has updated twice 
+        for(int k=0;k<query.count;k++)
+            state.moved[query.location(k)] = false;
 
         while(true) {
-            clean_double_collect = true;
+            bool clean_double_collect = true;
             // new snapshot
-            StampedSnap<T>* new_copy = collect();
-            for(int j=0;j<capacity;j++) {
-                if(old_copy[j].stamped_snap.load().stamp != new_copy[j].stamped_snap.load().stamp) {
+            collect(query, new_copy);
+            state.retries++;
+            for(int k=0;k<query.count;k++) {
+                if(old_copy[k].stamp != new_copy[k].stamp) {
+                    int j = query.location(k);
                     // if atleast one of the register's stamp is not equal, then its not clean double collect
                     clean_double_collect = false;
                     // case of double update by some thread
-                    if(moved[j]) {
+                    if(state.moved[j]) {
                         //cout<<"double move"<<endl;
-                        //delete[] old_copy;
-                        return new_copy[j].stamped_snap.load().snap;
-                    } else {
-                        moved[j] = true;
-                        //delete[] old_copy;
-                        old_copy = new_copy;
+                        // snap can't be reused by writer while thread is inside epoch
+                        // snap covers every register, hence it covers the query as well
+                        T* snap = new_copy[k].snap;
+                        for(int l=0;l<query.count;l++)
+                            result[l] = snap[query.location(l)];
+                        return;
                     }
+                    state.moved[j] = true;
                 }
             }
             // returning in case of clean double collect
             if(clean_double_collect) {
                 //cout<<"clean collect"<<endl;
-                //delete[] old_copy;
-                T* result = new T[capacity];
-                for(int j=0;j<capacity;j++) 
-                    result[j] = new_copy[j].stamped_snap.load().value;
-                //delete[] new_copy;
-                return result;
+                for(int k=0;k<query.count;k++) 
+                    result[k] = new_copy[k].value;
+                return;
+            }
+            swap(old_copy, new_copy);
+        }
+    }
+
+    // query of every register
+    Query fullQuery() {
+        Query query = {NULL, 0, capacity};
+        return query;
+    }
+
+    // scan of given query into result buffer of thread
+    T* scanQuery(int thread_id, const Query& query) {
+        T* result = states[thread_id].result;
+        enterEpoch(thread_id);
+        scanInto(thread_id, query, result);
+        exitEpoch(thread_id);
+        return result;
+    }
+
+public:
+    MRSW_WFSnapshot() {}
+
+    MRSW_WFSnapshot(T init, int n_scanners) : states(n_threads + n_scanners) {
+        for(int i=0;i<capacity;i++) {
+            a_table.push_back(StampedSnap<T>(0, init, NULL));
+        }
+        global_epoch.store(0);
+        write_version.store(0);
+    }
+    
+    // collection of a_table array into given buffer
+    void collect(Stamped_Snap<T>* copy) {
+        collect(fullQuery(), copy);
+    }
+
+    // collection of registers in query into given buffer
+    void collect(const Query& query, Stamped_Snap<T>* copy) {
+        for(int k=0;k<query.count;k++) {
+            copy[k] = this->a_table[query.location(k)].stamped_snap.load();
+        }
+    }
+    
+    // snapshot by given thread_id
+    // returned array is owned by the snapshot object and is valid until next scan by same thread_id
+    T* scan(int thread_id) {
+        return scanQuery(thread_id, fullQuery());
+    }
+
+    // snapshot of registers at given indices, linearizable over those registers only
+    // k-th value of returned array belongs to indices[k], at most capacity indices are allowed
+    // a register repeated in indices would be seen moving twice by a single write and a stale
+    // snap would be returned, hence only distinct registers are scanned and then copied to
+    // every index which repeats them
+    T* scan(int thread_id, const vector<int>& indices) {
+        ThreadState<T>& state = states[thread_id];
+        int count = 0;
+        for(size_t k=0;k<indices.size();k++) {
+            int j = indices[k];
+            if(state.position[j] < 0) {
+                state.position[j] = count;
+                state.distinct[count++] = j;
             }
+            state.slot[k] = state.position[j];
         }
+        for(int d=0;d<count;d++)
+            state.position[state.distinct[d]] = -1;
+        Query query = {state.distinct, 0, count};
+        T* result = scanQuery(thread_id, query);
+        // slot[k] is at most k, so going down from the end never overwrites a value still to be copied
+        for(int k=(int)indices.size()-1;k>=0;k--)
+            result[k] = result[state.slot[k]];
+        return result;
+    }
+
+    // snapshot of count registers starting at first, linearizable over those registers only
+    T* scan(int thread_id, int first, int count) {
+        Query query = {NULL, first, count};
+        return scanQuery(thread_id, query);
+    }
+
+    // number of collects repeated after the first one by latest scan of thread_id
+    int retries(int thread_id) {
+        return states[thread_id].retries;
     }
 
     // update at given thread_id location with given value
     void update(int thread_id, T value) {
+        ThreadState<T>& state = states[thread_id];
         // take snapshot
-        T* snap = this->scan();
-        StampedSnap<T> old_value = this->a_table[thread_id];
-        // obtaining stamp of old value
-        long stamp = old_value.stamped_snap.load().stamp;
-        T* old_snap = old_value.stamped_snap.load().snap;
-        //delete[] old_snap;
+        T* snap = allocateSnap(state);
+        enterEpoch(thread_id);
+        scanInto(thread_id, fullQuery(), snap);
+        exitEpoch(thread_id);
+        // only this thread writes a_table[thread_id]
+        Stamped_Snap<T> old_value = this->a_table[thread_id].stamped_snap.load();
         // incrementing stamp
-        StampedSnap<T> new_value(stamp+1, value, snap);
+        StampedSnap<T> new_value(old_value.stamp+1, value, snap);
+        write_version.fetch_add(1);
         this->a_table[thread_id] = new_value;
+        // ending write in progress and counting it as completed
+        write_version.fetch_add(COMPLETED_WRITE - 1);
+        if(old_value.snap != NULL)
+            retireSnap(state, old_value.snap);
     }
     
     ~MRSW_WFSnapshot() {
+        for(int i=0;i<capacity;i++)
+            delete[] a_table[i].stamped_snap.load().snap;
         a_table.clear();
     }
 
 };
 
-// declaring MRSW snapshot object
-MRSW_WFSnapshot<int>* MRSW_snap_object;
+// node of tree snapshot, a leaf holds value of one register and an internal node
+// points to the versions of its children it was built from
+// a published node is never modified until it is reclaimed
+template <class T>
+class TreeNode {
+public:
+    T value;
+    TreeNode<T>* left;
+    TreeNode<T>* right;
+};
+
+// state of each thread using the tree snapshot object
+template <class T>
+class TreeThreadState {
+public:
+    // epoch announced while thread is reading tree nodes, QUIESCENT otherwise
+    atomic<unsigned long> epoch;
+    // result of most recent scan returned to the caller
+    T* result;
+    // failed compare and swaps of most recent update
+    int retries;
+    // nodes retired by this writer along with the epoch of retirement,
+    // used as a ring starting at retired_head
+    vector<pair<unsigned long, TreeNode<T>*>> retired;
+    size_t retired_head;
+    // retired nodes with epoch below safe_epoch can be reused
+    unsigned long safe_epoch;
+    // nodes replaced by current update, retired together when it finishes
+    vector<TreeNode<T>*> replaced;
+    // nodes which lost their compare and swap and were never published
+    vector<TreeNode<T>*> spare;
+    // padding to keep epochs of different threads on different cache lines
+    char padding[64];
+
+    TreeThreadState() {
+        epoch.store(QUIESCENT);
+        result = new T[capacity];
+        retries = 0;
+        retired_head = 0;
+        safe_epoch = 0;
+    }
+
+    ~TreeThreadState() {
+        delete[] result;
+        for(size_t i=retired_head;i<retired.size();i++)
+            delete retired[i].second;
+        for(auto node:spare)
+            delete node;
+    }
+};
+
+// MRSW wait free snapshot with O(log M) update and O(M) space
+// registers are leaves of a complete binary tree whose every position holds an atomic
+// pointer to an immutable node, update installs a new leaf and refreshes every ancestor
+// twice by building a node from current children and installing it with compare and swap
+// if both compare and swaps at a position fail, some refresh which started after the
+// first one succeeded, hence the ancestor already covers the new leaf
+// root is therefore a snapshot of all registers and scan only has to read it
+// unlike MRSW_WFSnapshot no register embeds a snap array, an update allocates
+// O(log M) small nodes instead of copying M values
+template <class T>
+class MRSW_TreeSnapshot {
+    // number of leaves, capacity rounded up to a power of two
+    int leaves;
+    // tree[1] is root, children of position p are 2p and 2p+1, register i is at leaves+i
+    vector<atomic<TreeNode<T>*>> tree;
+    // writers use thread ids 0 to n_threads-1, scanners use the ids after them
+    vector<TreeThreadState<T>> states;
+    // global epoch advanced after every update which retired nodes
+    atomic<unsigned long> global_epoch;
+
+    void enterEpoch(int thread_id) {
+        states[thread_id].epoch.store(global_epoch.load());
+    }
 
-// map containing writer thread events 
-// key is time and value is long entry of type string
-map<double, string> write_events;
+    void exitEpoch(int thread_id) {
+        states[thread_id].epoch.store(QUIESCENT);
+    }
+
+    // epoch below which no running or future thread can hold a retired node
+    unsigned long safeEpoch() {
+        // threads entering after this load announce at least this epoch
+        unsigned long min_epoch = global_epoch.load();
+        for(size_t i=0;i<states.size();i++)
+            min_epoch = min(min_epoch, states[i].epoch.load());
+        return min_epoch;
+    }
 
+    // node for current update, reusing a spare or a safely retired one
+    // safe epoch is recomputed only once enough nodes are waiting in the ring,
+    // so that scanning every thread's epoch costs O(1) per node amortized
+    TreeNode<T>* allocateNode(TreeThreadState<T>& state) {
+        if(!state.spare.empty()) {
+            TreeNode<T>* node = state.spare.back();
+            state.spare.pop_back();
+            return node;
+        }
+        if(state.retired_head < state.retired.size()) {
+            if(state.retired[state.retired_head].first >= state.safe_epoch
+                && state.retired.size() - state.retired_head >= states.size())
+                state.safe_epoch = safeEpoch();
+            if(state.retired[state.retired_head].first < state.safe_epoch) {
+                TreeNode<T>* node = state.retired[state.retired_head].second;
+                state.retired_head++;
+                // ring is empty, restarting it without releasing its memory
+                if(state.retired_head == state.retired.size()) {
+                    state.retired.clear();
+                    state.retired_head = 0;
+                }
+                return node;
+            }
+        }
+        return new TreeNode<T>;
+    }
+
+    // building node at position from current children and trying to install it
+    void refresh(TreeThreadState<T>& state, int position) {
+        TreeNode<T>* old_node = tree[position].load();
+        TreeNode<T>* node = allocateNode(state);
+        node->left = tree[2*position].load();
+        node->right = tree[2*position + 1].load();
+        if(tree[position].compare_exchange_strong(old_node, node))
+            state.replaced.push_back(old_node);
+        else {
+            state.spare.push_back(node);
+            state.retries++;
+        }
+    }
+
+    // copies leaves of subtree rooted at node, which covers registers from first onwards
+    void copyLeaves(TreeNode<T>* node, int first, int size, T* result) {
+        if(first >= capacity)
+            return;
+        if(size == 1) {
+            result[first] = node->value;
+            return;
+        }
+        copyLeaves(node->left, first, size/2, result);
+        copyLeaves(node->right, first + size/2, size/2, result);
+    }
+
+    // value of register at location in tree rooted at root
+    T leafValue(TreeNode<T>* root, int location) {
+        TreeNode<T>* node = root;
+        for(int bit=leaves/2;bit>0;bit/=2)
+            node = (location & bit) ? node->right : node->left;
+        return node->value;
+    }
+
+public:
+    MRSW_TreeSnapshot(T init, int n_scanners) : states(n_threads + n_scanners) {
+        leaves = 1;
+        while(leaves < capacity)
+            leaves *= 2;
+        tree = vector<atomic<TreeNode<T>*>>(2*leaves);
+        for(int i=0;i<leaves;i++)
+            tree[leaves + i].store(new TreeNode<T>{init, NULL, NULL});
+        for(int p=leaves-1;p>=1;p--)
+            tree[p].store(new TreeNode<T>{init, tree[2*p].load(), tree[2*p + 1].load()});
+        global_epoch.store(0);
+    }
+
+    // snapshot by given thread_id, copies the leaves of current root
+    // returned array is owned by the snapshot object and is valid until next scan by same thread_id
+    T* scan(int thread_id) {
+        T* result = states[thread_id].result;
+        enterEpoch(thread_id);
+        copyLeaves(tree[1].load(), 0, leaves, result);
+        exitEpoch(thread_id);
+        return result;
+    }
+
+    // snapshot of registers at given indices, O(log M) per index
+    T* scan(int thread_id, const vector<int>& indices) {
+        T* result = states[thread_id].result;
+        enterEpoch(thread_id);
+        TreeNode<T>* root = tree[1].load();
+        for(size_t k=0;k<indices.size();k++)
+            result[k] = leafValue(root, indices[k]);
+        exitEpoch(thread_id);
+        return result;
+    }
+
+    // snapshot of count registers starting at first
+    T* scan(int thread_id, int first, int count) {
+        T* result = states[thread_id].result;
+        enterEpoch(thread_id);
+        TreeNode<T>* root = tree[1].load();
+        for(int k=0;k<count;k++)
+            result[k] = leafValue(root, first + k);
+        exitEpoch(thread_id);
+        return result;
+    }
+
+    // failed compare and swaps of latest update of thread_id, scans never retry
+    int retries(int thread_id) {
+        return states[thread_id].retries;
+    }
+
+    // update at given thread_id location with given value
+    void update(int thread_id, T value) {
+        TreeThreadState<T>& state = states[thread_id];
+        state.retries = 0;
+        enterEpoch(thread_id);
+        TreeNode<T>* leaf = allocateNode(state);
+        leaf->value = value;
+        leaf->left = leaf->right = NULL;
+        // only this thread writes leaf of thread_id
+        state.replaced.push_back(tree[leaves + thread_id].exchange(leaf));
+        for(int p=(leaves + thread_id)/2;p>=1;p/=2) {
+            refresh(state, p);
+            refresh(state, p);
+        }
+        exitEpoch(thread_id);
+        // replaced nodes are unreachable from current root once ancestors are refreshed,
+        // threads entering after this increment cannot reach them
+        unsigned long epoch = global_epoch.fetch_add(1);
+        for(auto node:state.replaced)
+            state.retired.push_back(make_pair(epoch, node));
+        state.replaced.clear();
+    }
+
+    ~MRSW_TreeSnapshot() {
+        for(size_t p=1;p<tree.size();p++)
+            delete tree[p].load();
+    }
+};
+
+// kind of logged event
+const int WRITE_EVENT = 0;
+const int SNAPSHOT_EVENT = 1;
+
+// fixed size binary record of a write or a snapshot, turned into text only
+// when the output file is written
+class Event {
+public:
+    // microseconds since start, used to merge logs of all threads
+    long time;
+    int kind;
+    // writer thread id or snapshot thread id
+    int thread_id;
+    // written value of write event
+    int value;
+    // snapshot event keeps its registers at values_offset in snapshot_values of its log
+    long values_offset;
+};
+
+// log of one thread, only touched by that thread until it finishes
+// buffers are reserved up front so that logging does not allocate while thread runs
+class EventLog {
+public:
+    vector<Event> events;
+    // for every snapshot event, queried locations (partial snapshot only) followed by values
+    vector<int> snapshot_values;
+
+    void reserve(size_t n_events, size_t n_values) {
+        events.clear();
+        snapshot_values.clear();
+        events.reserve(n_events);
+        snapshot_values.reserve(n_values);
+    }
+};
+
+// logs of writer threads and snapshot threads
+vector<EventLog> writer_logs;
+vector<EventLog> snapshot_logs;
+// wall clock time of start, event times are offsets from it in microseconds
+chrono::system_clock::time_point start_wall_time;
+
+// number of registers logged by a snapshot
+int snapshotSize() {
+    return query_size > 0 ? query_size : capacity;
+}
+
+// renders event as a line of text in the format of the log
+void renderEvent(ostream& out, const Event& event, const EventLog& log) {
+    time_t event_time_t = chrono::system_clock::to_time_t(start_wall_time + chrono::microseconds(event.time));
+    tm* event_time = localtime(&event_time_t);
+    if(event.kind == WRITE_EVENT) {
+        out<<"Thr"<<event.thread_id<<"'s write of "<<event.value<<" "<< "at "<<event_time->tm_hour<<":"<<event_time->tm_min<<":"<<event_time->tm_sec<<"\n";
+        return;
+    }
+    out<<"Snapshot Thr"<<event.thread_id<<"'s snapshot: ";
+    const int* values = log.snapshot_values.data() + event.values_offset;
+    if(query_size > 0) {
+        for(int i=0;i<query_size;i++)
+            out<<"l"<<values[i]<<"-"<<values[query_size + i]<<" ";
+    } else {
+        for(int i=0;i<capacity;i++)
+            out<<"l"<<i<<"-"<<values[i]<<" ";
+    }
+    out<<" which finished at "<<event_time->tm_hour<<":"<<event_time->tm_min<<":"<<event_time->tm_sec<<"\n";
+}
+
+// merges logs of all threads by time and renders them onto output file
+// every log is already sorted, so a k-way merge with a heap of the next event of each log
+// is enough, events with equal times are all kept
+void writeEvents() {
+    vector<const EventLog*> logs;
+    for(auto& log:writer_logs)
+        logs.push_back(&log);
+    for(auto& log:snapshot_logs)
+        logs.push_back(&log);
+    // heap of (time, log, position of event in log), smallest time on top
+    typedef tuple<long, size_t, size_t> HeapEntry;
+    priority_queue<HeapEntry, vector<HeapEntry>, greater<HeapEntry>> heap;
+    for(size_t i=0;i<logs.size();i++)
+        if(!logs[i]->events.empty())
+            heap.push(make_tuple(logs[i]->events[0].time, i, 0));
+    while(!heap.empty()) {
+        size_t log_index = get<1>(heap.top());
+        size_t position = get<2>(heap.top());
+        heap.pop();
+        const EventLog& log = *logs[log_index];
+        renderEvent(output_file, log.events[position], log);
+        if(position + 1 < log.events.size())
+            heap.push(make_tuple(log.events[position + 1].time, log_index, position + 1));
+    }
+}
 
 // writer thread
-void writer(int thread_id) {
+template <class S>
+void writer(S* MRSW_snap_object, int thread_id) {
     //srand(time(NULL));
-    map<double, string> local_write_events;
+    EventLog& log = writer_logs[thread_id];
     // exponential_distribution for delay
     exponential_distribution<double> exponential_1((double)1/(double)lambda_1);
-    while(!terminate_writer_thread) {
-        // thread local string stream
-        stringstream local_output;
+    // number of writes done by this thread
+    long writes = 0;
+    auto begin_time = chrono::high_resolution_clock::now();
+    while(n_writes > 0 ? writes < n_writes : !terminate_writer_thread) {
         int value = rand();
         //int location = rand() % capacity;
         MRSW_snap_object->update(thread_id, value);
         auto enter_time = chrono::high_resolution_clock::now(); 
-        time_t entry_time_t = time(0);
-        tm* entry_time = localtime(&entry_time_t);
-        local_output<<"Thr"<<thread_id<<"'s write of "<<value<<" "<< "at "<<entry_time->tm_hour<<":"<<entry_time->tm_min<<":"<<entry_time->tm_sec<<"\n";
-        double time_taken = chrono::duration_cast<chrono::microseconds>(enter_time - start).count();
-        // time in seconds
-        time_taken /= 1000000;
-        // storing write event onto local events map
-        local_write_events[time_taken] = local_output.str();
-        //record system time and value v in local log
+        // record time and value in local log, text is rendered after threads finish
+        Event event;
+        event.time = chrono::duration_cast<chrono::microseconds>(enter_time - start).count();
+        event.kind = WRITE_EVENT;
+        event.thread_id = thread_id;
+        event.value = value;
+        event.values_offset = 0;
+        log.events.push_back(event);
         sleep(exponential_1(generator));
+        writes++;
     }
-
-    // using lock for writing events into map, since multiple threads can write onto map
-    // and to guarantee safety, used lock although it won't affect output result times
-    output_file_lock.lock();
-    for(auto event:local_write_events)
-        write_events[event.first] = event.second;
-    output_file_lock.unlock();
-    // output_file<<local_output.rdbuf();
+    double duration = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - begin_time).count()/(double)1000000;
+    writer_throughput[thread_id] = writes/duration;
 }
 
 
-// snapshot thread
-void snapshot() {
+// snapshot thread, scanner_id ranges from 0 to n_scanners-1
+template <class S>
+void snapshot(S* MRSW_snap_object, int scanner_id) {
+    // snapshot threads use the thread ids after writers
+    int thread_id = n_threads + scanner_id;
+    EventLog& log = snapshot_logs[scanner_id];
     // count of snapshots
     int count = 0;
-    // local map for log entries
-    map<double, string> local_write_events;
+    // snapshot times and retries of this thread
+    double local_completion_time = 0, local_worst_case_time = 0;
+    Histogram local_scan_time_histogram, local_retry_histogram;
+    vector<double> local_scan_times;
+    local_scan_times.reserve(n_snapshots);
+    auto begin_time = chrono::high_resolution_clock::now();
     // exponential_distribution for delay
     exponential_distribution<double> exponential_2((double)1/(double)lambda_2);
+    // registers read by a partial snapshot
+    vector<int> query(query_size);
     while(count < n_snapshots) {
-        // thread local string stream
-        stringstream local_output;
+        // choosing registers of partial snapshot
+        for(int i=0;i<query_size;i++)
+            query[i] = rand() % capacity;
         // begin collect time
         auto high_res_begin_collect_time = chrono::high_resolution_clock::now();
-        time_t begin_collect_time_t = time(0);
-        tm* begin_collect_time = localtime(&begin_collect_time_t);
         
-        // call snapshot 
-        int* collect = MRSW_snap_object->scan();
+        // call snapshot
+        int* collect = query_size > 0 ? MRSW_snap_object->scan(thread_id, query) : MRSW_snap_object->scan(thread_id);
         
         // end collect time
         auto high_res_end_collect_time = chrono::high_resolution_clock::now();
-        time_t end_collect_time_t = time(0);
-        tm* end_collect_time = localtime(&end_collect_time_t);
 
         // time taken to collect snapshot
         double time_taken = chrono::duration_cast<chrono::microseconds>(high_res_end_collect_time - high_res_begin_collect_time).count();
-        avg_completion_time += time_taken;
-        worst_case_time = max(worst_case_time, time_taken);
-
-        local_output<<"Snapshot Thr's snapshot: ";
-        for(int i=0;i<capacity;i++)
-            local_output<<"l"<<i<<"-"<<collect[i]<<" ";
-        local_output<<" which finished at "<<end_collect_time->tm_hour<<":"<<end_collect_time->tm_min<<":"<<end_collect_time->tm_sec<<"\n";
-        
-        double time_diff = chrono::duration_cast<chrono::microseconds>(high_res_end_collect_time - start).count();
-        // time in seconds
-        time_diff /= 1000000;
-        // storing write event onto local events map
-        local_write_events[time_diff] = local_output.str();
+        local_completion_time += time_taken;
+        local_worst_case_time = max(local_worst_case_time, time_taken);
+        local_scan_time_histogram.add((long)time_taken);
+        local_retry_histogram.add(MRSW_snap_object->retries(thread_id));
+        local_scan_times.push_back(time_taken);
 
-        //delete[] collect;
+        // copying snapshot into local log, collect is owned by snapshot object and reused by next snapshot
+        Event event;
+        event.time = chrono::duration_cast<chrono::microseconds>(high_res_end_collect_time - start).count();
+        event.kind = SNAPSHOT_EVENT;
+        event.thread_id = scanner_id;
+        event.values_offset = log.snapshot_values.size();
+        log.snapshot_values.insert(log.snapshot_values.end(), query.begin(), query.end());
+        log.snapshot_values.insert(log.snapshot_values.end(), collect, collect + snapshotSize());
+        log.events.push_back(event);
 
         sleep(exponential_2(generator));
         count++;
     }
-    // using lock for writing events into map, since multiple threads can write onto map
-    // and to guarantee safety, used lock although it won't affect output result times
+    double duration = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - begin_time).count()/(double)1000000;
+    scanner_throughput[scanner_id] = count/duration;
+
+    // merging statistics of this thread, lock is needed since multiple snapshot threads merge
     output_file_lock.lock();
-    for(auto event:local_write_events)
-        write_events[event.first] = event.second;
+    avg_completion_time += local_completion_time;
+    worst_case_time = max(worst_case_time, local_worst_case_time);
+    scan_time_histogram.merge(local_scan_time_histogram);
+    retry_histogram.merge(local_retry_histogram);
+    scan_times.insert(scan_times.end(), local_scan_times.begin(), local_scan_times.end());
     output_file_lock.unlock();
 }
 
-
-int main() {
-    // seed for default random engine generator
-    generator.seed(4);
-    
-    // input file stream
-    ifstream input_file;
-    input_file.open("inp-params.txt");
-    
-    // output file stream
-    output_file.open("output.txt");
-
-    // lambda_1 is average delay for writer thread and lambda_2 is average delay for snapshot thread
-    input_file >> n_threads >> capacity >> lambda_1 >> lambda_2 >> n_snapshots;
-    
-    //capacity = n_threads;
-
-    // instantiating MRSW Snapshot object
-    MRSW_snap_object = new MRSW_WFSnapshot<int>(0);
-
+// runs writer threads and snapshot threads on given snapshot object,
+// writes their logs onto output file and prints snapshot times
+template <class S>
+void runSnapshotTest(string name, S* MRSW_snap_object) {
     // writer threads
     thread writer_threads[n_threads];
-    // one snapshot thread
-    thread snapshot_thread;
-    
+    // snapshot threads
+    thread snapshot_threads[n_scanners];
+
+    terminate_writer_thread = false;
     start = chrono::high_resolution_clock::now();
+    start_wall_time = chrono::system_clock::now();
     avg_completion_time = 0.0;
     worst_case_time = 0;
+    scan_time_histogram = Histogram();
+    retry_histogram = Histogram();
+    scan_times.clear();
+    writer_throughput.assign(n_threads, 0);
+    scanner_throughput.assign(n_scanners, 0);
+    // preallocating logs, a writer running until snapshot threads finish starts
+    // with room for the average number of writes and grows if it needs more
+    writer_logs.resize(n_threads);
+    for(int i=0;i<n_threads;i++)
+        writer_logs[i].reserve(n_writes > 0 ? n_writes : n_snapshots, 0);
+    snapshot_logs.resize(n_scanners);
+    for(int i=0;i<n_scanners;i++)
+        snapshot_logs[i].reserve(n_snapshots, (size_t)n_snapshots*(query_size + snapshotSize()));
 
     // creating writer threads
     for(int i=0;i<n_threads;i++)
-        writer_threads[i] = thread(writer, i);
+        writer_threads[i] = thread(writer<S>, MRSW_snap_object, i);
 
-    // creating snapshot thread
-    snapshot_thread = thread(snapshot);
+    // creating snapshot threads
+    for(int i=0;i<n_scanners;i++)
+        snapshot_threads[i] = thread(snapshot<S>, MRSW_snap_object, i);
 
-    // wait until snapshot thread terminates;
-    snapshot_thread.join();
+    // wait until snapshot threads terminate;
+    for(int i=0;i<n_scanners;i++)
+        snapshot_threads[i].join();
 
     // inform writer threads that they have to terminate
     terminate_writer_thread = true; 
@@ -304,17 +902,159 @@ int main() {
     for(int i=0;i<n_threads;i++)
         writer_threads[i].join();
 
-    // write all writer log entries onto file
-    // Log entries are sorted by their time of entry
-    for(auto event:write_events) {
-        output_file<<event.second;
-    }
-
-    write_events.clear();
+    // write all log entries onto file
+    // Log entries are merged by their time of entry
+    writeEvents();
 
-    avg_completion_time /= n_snapshots;
+    avg_completion_time /= (double)n_snapshots*n_scanners;
+    cout<<name<<endl;
     cout<<"Average waiting time for taking snapshot is "<<avg_completion_time<<endl;
     cout<<"Worst case time to take snapshot is "<<worst_case_time<<endl;
+    for(int i=0;i<n_threads;i++)
+        cout<<"Writer thread "<<i<<" throughput (writes per second): "<<writer_throughput[i]<<endl;
+    for(int i=0;i<n_scanners;i++)
+        cout<<"Snapshot thread "<<i<<" throughput (snapshots per second): "<<scanner_throughput[i]<<endl;
+    scan_time_histogram.print("Histogram of snapshot times (in microseconds)");
+    retry_histogram.print("Histogram of repeated collects per snapshot");
+
+    sort(scan_times.begin(), scan_times.end());
+    BenchmarkResult result;
+    result.name = name;
+    result.writes_per_second = 0;
+    for(int i=0;i<n_threads;i++)
+        result.writes_per_second += writer_throughput[i];
+    result.snapshots_per_second = 0;
+    for(int i=0;i<n_scanners;i++)
+        result.snapshots_per_second += scanner_throughput[i];
+    result.avg_time = avg_completion_time;
+    result.p50_time = scan_times[scan_times.size()/2];
+    result.p99_time = scan_times[scan_times.size()*99/100];
+    result.worst_time = worst_case_time;
+    benchmark_results.push_back(result);
+}
+
+// prints results of all snapshot objects side by side
+void printComparison() {
+    cout<<"\nComparison (writes and snapshots per second summed over threads, snapshot times in microseconds)"<<endl;
+    cout<<left<<setw(45)<<"Snapshot object"<<right<<setw(14)<<"writes/s"<<setw(14)<<"snapshots/s"
+        <<setw(12)<<"avg"<<setw(12)<<"p50"<<setw(12)<<"p99"<<setw(12)<<"max"<<endl;
+    for(auto& result:benchmark_results) {
+        cout<<left<<setw(45)<<result.name<<right<<fixed<<setprecision(0)
+            <<setw(14)<<result.writes_per_second<<setw(14)<<result.snapshots_per_second
+            <<setprecision(2)<<setw(12)<<result.avg_time<<setw(12)<<result.p50_time
+            <<setw(12)<<result.p99_time<<setw(12)<<result.worst_time<<endl;
+        cout.unsetf(ios::fixed);
+        cout<<setprecision(6);
+    }
+}
+
+// writer i writes 1, 2, 3, ... to its register while the snapshot thread scans a query which
+// names the first half of the registers twice each, a long query so that writes often land
+// inside a scan. A scan is stale if a register is below the last value written before the scan
+// started or above the last value whose write started before it ended, and inconsistent if the
+// two positions of a register differ
+void repeatedQueryTest(long updates) {
+    MRSW_WFSnapshot<int>* snap_object = new MRSW_WFSnapshot<int>(0, 1);
+    int m = max(1, capacity/2);
+    vector<int> query;
+    for(int i=0;i<m;i++) {
+        query.push_back(i);
+        query.push_back(i);
+    }
+    vector<atomic<int>> started(n_threads), finished(n_threads);
+    for(int i=0;i<n_threads;i++) {
+        started[i].store(0);
+        finished[i].store(0);
+    }
+    atomic<int> running_writers(n_threads);
+    thread writer_threads[n_threads];
+    for(int i=0;i<n_threads;i++) {
+        writer_threads[i] = thread([=, &started, &finished, &running_writers]() {
+            for(int value=1;value<=updates;value++) {
+                started[i].store(value);
+                snap_object->update(i, value);
+                finished[i].store(value);
+            }
+            running_writers--;
+        });
+    }
+    // snapshot thread
+    int thread_id = n_threads;
+    vector<int> lower(m), upper(m);
+    long scans = 0, retried = 0, stale = 0, inconsistent = 0;
+    while(running_writers.load() > 0) {
+        for(int i=0;i<m;i++)
+            lower[i] = i < n_threads ? finished[i].load() : 0;
+        int* result = snap_object->scan(thread_id, query);
+        for(int i=0;i<m;i++)
+            upper[i] = i < n_threads ? started[i].load() : 0;
+        scans++;
+        if(snap_object->retries(thread_id) > 0)
+            retried++;
+        for(int i=0;i<m;i++) {
+            if(result[2*i] != result[2*i + 1])
+                inconsistent++;
+            else if(result[2*i] < lower[i] || result[2*i] > upper[i])
+                stale++;
+        }
+    }
+    for(int i=0;i<n_threads;i++)
+        writer_threads[i].join();
+    cout<<"Repeated index query of "<<query.size()<<" indices over "<<m<<" registers"<<endl;
+    cout<<"Scans: "<<scans<<", with writers active: "<<retried<<", stale registers: "<<stale
+        <<", inconsistent registers: "<<inconsistent<<endl;
+    delete snap_object;
+}
+
+int main(int argc, char* argv[]) {
+    // seed for default random engine generator
+    generator.seed(4);
+    
+    // input file stream
+    ifstream input_file;
+    input_file.open("inp-params.txt");
+    
+    // output file stream
+    output_file.open("output.txt");
+
+    // lambda_1 is average delay for writer thread and lambda_2 is average delay for snapshot thread
+    input_file >> n_threads >> capacity >> lambda_1 >> lambda_2 >> n_snapshots;
+    // optional size of partial snapshot
+    if(!(input_file >> query_size))
+        query_size = 0;
+    query_size = min(query_size, capacity);
+    // optional number of snapshot threads and number of writes by each writer
+    if(!(input_file >> n_scanners))
+        n_scanners = 1;
+    if(!(input_file >> n_writes))
+        n_writes = 0;
+    
+    //capacity = n_threads;
+    if(capacity < n_threads) {
+        cout<<"Every writer thread needs its own register, M must be at least n"<<endl;
+        return 1;
+    }
+
+    // ./mrsw repeat [updates] checks scans of a query repeating every index while writers run
+    if(argc > 1 && string(argv[1]) == "repeat") {
+        repeatedQueryTest(argc > 2 ? atol(argv[2]) : 1000000);
+        return 0;
+    }
+
+    // snapshot which embeds a snap array in every register
+    output_file<<"Double collect snapshot:\n";
+    MRSW_WFSnapshot<int>* MRSW_snap_object = new MRSW_WFSnapshot<int>(0, n_scanners);
+    runSnapshotTest("Double collect snapshot (MRSW_WFSnapshot)", MRSW_snap_object);
+    // freeing snapshot object along with all snap arrays
+    delete MRSW_snap_object;
+
+    // snapshot with O(log M) update
+    output_file<<"\nTree snapshot:\n";
+    MRSW_TreeSnapshot<int>* tree_snap_object = new MRSW_TreeSnapshot<int>(0, n_scanners);
+    runSnapshotTest("Tree snapshot (MRSW_TreeSnapshot)", tree_snap_object);
+    delete tree_snap_object;
+
+    printComparison();
 
     // cleanup i.e. closing all the files
     input_file.close();
@@ -0,0 +1,212 @@
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <ctime>
+#include <math.h>
+#include <unistd.h>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <stdlib.h>
+#include <new>
+using namespace std;
+
+// size of a cache line, every slot is padded to it so that
+// every waiter spins on a cache line of its own
+const int CACHE_LINE = 64;
+
+// hint to the processor that thread is busy waiting
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// slot of Anderson lock, flag is true when thread waiting on slot may enter
+class PaddedSlot {
+public:
+    atomic<bool> flag;
+    char padding[CACHE_LINE - sizeof(atomic<bool>)];
+};
+
+// Anderson's array based queue lock
+// a thread takes the next slot of a circular array with fetch_add and spins on the flag
+// of its slot, releasing sets flag of next slot, hence every waiter spins on a separate
+// cache line and a release invalidates only the line of the next waiter
+// at most capacity threads may use the lock at the same time
+class AndersonLock {
+    // cache line aligned array of capacity slots
+    PaddedSlot* slots;
+    uint32_t capacity;
+    // number of slots handed out so far, 64 bit so it does not wrap
+    atomic<uint64_t> tail;
+    // slot of current lock holder, written only by holder
+    uint32_t holder_slot;
+public:
+
+    AndersonLock(int capacity) {
+        this->capacity = capacity;
+        void* memory = NULL;
+        if(posix_memalign(&memory, CACHE_LINE, capacity*sizeof(PaddedSlot)) != 0)
+            throw bad_alloc();
+        slots = (PaddedSlot*)memory;
+        // first thread may enter right away
+        for(int i=0;i<capacity;i++)
+            new(&slots[i].flag) atomic<bool>(i == 0);
+        tail.store(0);
+    }
+
+    void lock() {
+        uint32_t slot = tail.fetch_add(1) % capacity;
+        while(!slots[slot].flag.load(memory_order_acquire))
+            cpuRelax();
+        holder_slot = slot;
+    }
+
+    void unlock() {
+        uint32_t slot = holder_slot;
+        // slot is reused capacity acquires later, its flag has to be false by then
+        slots[slot].flag.store(false, memory_order_relaxed);
+        slots[(slot + 1) % capacity].flag.store(true, memory_order_release);
+    }
+
+    ~AndersonLock() {
+        free(slots);
+    }
+};
+
+
+// Critical section entry time taken by each thread
+double cs_enter_time;
+// Critical section exit time taken by each thread
+double cs_exit_time;
+
+// output file stream
+ofstream output_file;
+
+// random number generator
+default_random_engine generator;
+
+mutex increment_lock;
+
+/***************************************************************
+TO CHECK CORRECTNESS COMMENT OUT MESSAGE 1 AND MESSAGE 4
+SINCE IF ALL MESSAGES ARE PRINTED THEN INTERLEAVING OF CHARACTER 
+MAY HAPPEN SINCE COUT DOESN'T USE LOCKS.
+FPRINTF CAN BE USED IF OUTPUT MESSAGES ARE IMPORTANT SINCE IT
+INTERNALLY USES LOCKS.
+FOR CORRECTNESS I.E. TO ENSURE MUTUAL EXCLUSION, MESSAGE 2 
+AND 3 SHOULDN'T BE INTERLEAVED. HENCE MESSAGES 1 AND 4 CAN
+BE COMMENTED.
+****************************************************************/
+
+
+// test function for critical section where thread enters the CS no_of_entries times
+// and lambda_1 is average of delay for simulating CS task which is exponentially distributed
+// and similarly lambda_2 is average of delay for exit section which is also exponentially
+// distributed
+template <class L>
+void testCS(int thread_id, int no_of_entries, double lambda_1, double lambda_2, L* anderson_lock) {
+    // exponential_distribution for Critical section sleep delay
+    exponential_distribution<double> exponential_1((double)1/(double)lambda_1);
+    // exponential_distribution for Exit section sleep delay
+    exponential_distribution<double> exponential_2((double)1/(double)lambda_2);
+    // Thread requesting to enter CS for no_of_entries times
+    // only msg 2 and msg 3 are logged, mutual exclusion holds if they never interleave
+    for(int i=0;i<no_of_entries;i++) {
+
+        // Request Entry
+        auto high_res_request_entry_time = chrono::high_resolution_clock::now();
+        
+        // Actual Entry in Critical Section
+        anderson_lock->lock();
+        auto high_res_actual_entry_time = chrono::high_resolution_clock::now();
+        time_t actual_entry_time_t = time(0);
+        tm* actual_entry_time = localtime(&actual_entry_time_t);
+        sleep(exponential_1(generator));
+        output_file<<i+1<<"th CS Entry at "<< actual_entry_time->tm_hour<<":"<<actual_entry_time->tm_min<<":"<<actual_entry_time->tm_sec<<" by thread "<<thread_id<<" (mesg 2)\n"<<flush;
+    
+        // CS enter time in seconds
+        cs_enter_time += chrono::duration_cast<chrono::microseconds>( high_res_actual_entry_time - high_res_request_entry_time ).count()/(double)(pow(10,6));
+
+        // Request Exit
+        auto high_res_request_exit_time = chrono::high_resolution_clock::now();
+        time_t request_exit_time_t = time(0);
+        tm* request_exit_time = localtime(&request_exit_time_t);
+        output_file<<i+1<<"th CS Exit Request at "<< request_exit_time->tm_hour<<":"<<request_exit_time->tm_min<<":"<<request_exit_time->tm_sec<<" by thread "<<thread_id<<" (mesg 3)\n"<<flush;
+
+        anderson_lock->unlock();
+
+        // Actual Exit 
+        auto high_res_actual_exit_time = chrono::high_resolution_clock::now();
+        
+        // CS exit time in microseconds, since it is in order of microseconds
+        // since cs_exit_time is shared variable, need to add a lock
+        // no lock needed in case of cs_entry_time since it is updated inside lock
+        increment_lock.lock();
+        cs_exit_time += chrono::duration_cast<chrono::microseconds>( high_res_actual_exit_time - high_res_request_exit_time ).count();
+        increment_lock.unlock();
+        sleep(exponential_2(generator));
+    }
+}
+
+
+
+int main() {
+    // seed for default random engine generator
+    generator.seed(4);
+
+    // input file stream
+    ifstream input_file;
+    input_file.open("inp-params.txt");
+    // output file stream
+    output_file.open("output.txt");
+
+    // parameters of input file
+    int no_of_threads, no_of_entries;
+    double lambda_1, lambda_2;
+
+    input_file >> no_of_threads >> no_of_entries >> lambda_1 >> lambda_2;
+
+    // threads for Anderson Lock
+    thread Anderson_threads[no_of_threads]; 
+
+    // initializing Anderson Lock
+    AndersonLock* anderson_lock = new AndersonLock(no_of_threads);
+
+    // Anderson Lock
+    cs_enter_time = 0;
+    cs_exit_time = 0;
+    output_file<<"Anderson Lock Output:\n"<<flush;
+    // process cpu time before creating threads
+    clock_t cpu_start_time = clock();
+
+    for(int i=0;i<no_of_threads;i++) {
+        Anderson_threads[i] = thread(testCS<AndersonLock>, i, no_of_entries, lambda_1, lambda_2, anderson_lock);
+    }
+
+    for(int i=0;i<no_of_threads;i++)
+        Anderson_threads[i].join();
+
+    // cpu time consumed by all threads in seconds
+    double cpu_time = (double)(clock() - cpu_start_time)/(double)CLOCKS_PER_SEC;
+    // average cs entry time
+    double average_cs_enter_time = (double)cs_enter_time/(double)(no_of_threads*no_of_entries);
+    // average cs exit time
+    double average_cs_exit_time = (double)cs_exit_time/(double)(no_of_threads*no_of_entries);
+    cout<<"Anderson Lock"<<endl;
+    cout<<"Average Entry time (in seconds): "<<average_cs_enter_time<<endl;
+    cout<<"Average Exit time (in seconds): "<<average_cs_exit_time<<endl;
+    cout<<"CPU time consumed (in seconds): "<<cpu_time<<endl;
+
+    delete anderson_lock;
+
+    // cleanup i.e. closing all the files
+    input_file.close();
+    output_file.close();
+    return 0;
+}
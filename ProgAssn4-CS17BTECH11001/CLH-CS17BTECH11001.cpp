@@ -11,59 +11,10 @@
 #include <algorithm>
 #include <mutex>
 #include <atomic>
+#include "QueueLocks-CS17BTECH11001.h"
 using namespace std;
 
 
-// QNode class
-class QNode {
-public:
-    // locked begin true indicates thread has either 
-    // acquired lock or waiting for lock
-    // false indicates that thread has released it
-    bool locked;
-
-    QNode() {
-        this->locked = true;
-    }
-};
-
-// declaring thread_local my_node and my_pred for threads
-static thread_local QNode* my_node = new QNode();
-static thread_local QNode* my_pred = new QNode();
-
-class CLHLock {
-public:
-    // atomic tail node pointer
-    atomic<QNode*> tail;
-
-    CLHLock() {
-        QNode* tail_node = new QNode();
-        tail_node->locked = false;
-        tail.store({tail_node});
-    }
-
-    // my_node and my_pred are thread local nodes 
-    void lock() {
-        my_node->locked = true;
-        QNode* pred = atomic_exchange(&tail, my_node);
-        my_pred = pred;
-        while(pred->locked) {}
-    }
-
-    // my_node and my_pred are thread local nodes 
-    void unlock() {
-        my_node->locked = false;
-        my_node = my_pred;
-    }
-
-
-    ~CLHLock() {
-        // freeing tail pointer
-        delete tail;
-    }
-};
-
-
 // Critical section entry time taken by each thread
 double cs_enter_time;
 // Critical section exit time taken by each thread
@@ -92,8 +43,9 @@ BE COMMENTED.
 // test function for critical section where thread enters the CS no_of_entries times
 // and lambda_1 is average of delay for simulating CS task which is exponentially distributed
 // and similarly lambda_2 is average of delay for exit section which is also exponentially
-// distributed and my_nodes is local my_node for thread and my_preds is local my_pred for thread
-void testCS(int thread_id, int no_of_entries, double lambda_1, double lambda_2, CLHLock* clh_lock) {
+// distributed
+template <class L>
+void testCS(int thread_id, int no_of_entries, double lambda_1, double lambda_2, L* clh_lock) {
     // exponential_distribution for Critical section sleep delay
     exponential_distribution<double> exponential_1((double)1/(double)lambda_1);
     // exponential_distribution for Exit section sleep delay
@@ -144,7 +96,16 @@ void testCS(int thread_id, int no_of_entries, double lambda_1, double lambda_2,
 }
 
 
-int main() {
+int main(int argc, char* argv[]) {
+    // ./clh churn [cycles] creates and destroys locks cycles times (default 10^6) from 4 threads
+    // which also share one lock, build with -fsanitize=address to check node ownership
+    if(argc > 1 && string(argv[1]) == "churn") {
+        long cycles = argc > 2 ? atol(argv[2]) : 1000000;
+        cout<<"CLHLock lost increments: "<<lockChurn<CLHLock>(cycles, 4, 64)<<endl;
+        cout<<"CLHParkLock lost increments: "<<lockChurn<CLHParkLock>(cycles, 4, 64)<<endl;
+        return 0;
+    }
+
     // seed for default random engine generator
     generator.seed(4);
 
@@ -171,14 +132,18 @@ int main() {
     cs_enter_time = 0;
     cs_exit_time = 0;
     output_file<<"CLH Lock Output:\n"<<flush;
+    // process cpu time before creating threads
+    clock_t cpu_start_time = clock();
 
     for(int i=0;i<no_of_threads;i++) {
-        CLH_threads[i] = thread(testCS, i, no_of_entries, lambda_1, lambda_2, clh_lock);
+        CLH_threads[i] = thread(testCS<CLHLock>, i, no_of_entries, lambda_1, lambda_2, clh_lock);
     }
 
     for(int i=0;i<no_of_threads;i++)
         CLH_threads[i].join();
 
+    // cpu time consumed by all threads in seconds
+    double cpu_time = (double)(clock() - cpu_start_time)/(double)CLOCKS_PER_SEC;
     // average cs entry time
     double average_cs_enter_time = (double)cs_enter_time/(double)(no_of_threads*no_of_entries);
     // average cs exit time
@@ -186,6 +151,35 @@ int main() {
     cout<<"CLH Lock"<<endl;
     cout<<"Average Entry time (in seconds): "<<average_cs_enter_time<<endl;
     cout<<"Average Exit time (in seconds): "<<average_cs_exit_time<<endl;
+    cout<<"CPU time consumed (in seconds): "<<cpu_time<<endl;
+
+    // initializing CLH spin-then-park Lock
+    CLHParkLock* clh_park_lock = new CLHParkLock();
+
+    // CLH spin-then-park lock
+    cs_enter_time = 0;
+    cs_exit_time = 0;
+    output_file<<"\nCLH Spin-then-Park Lock Output:\n"<<flush;
+    cpu_start_time = clock();
+
+    for(int i=0;i<no_of_threads;i++) {
+        CLH_threads[i] = thread(testCS<CLHParkLock>, i, no_of_entries, lambda_1, lambda_2, clh_park_lock);
+    }
+
+    for(int i=0;i<no_of_threads;i++)
+        CLH_threads[i].join();
+
+    cpu_time = (double)(clock() - cpu_start_time)/(double)CLOCKS_PER_SEC;
+    average_cs_enter_time = (double)cs_enter_time/(double)(no_of_threads*no_of_entries);
+    average_cs_exit_time = (double)cs_exit_time/(double)(no_of_threads*no_of_entries);
+    cout<<"CLH Spin-then-Park Lock"<<endl;
+    cout<<"Average Entry time (in seconds): "<<average_cs_enter_time<<endl;
+    cout<<"Average Exit time (in seconds): "<<average_cs_exit_time<<endl;
+    cout<<"CPU time consumed (in seconds): "<<cpu_time<<endl;
+
+    // freeing locks along with their nodes
+    delete clh_lock;
+    delete clh_park_lock;
 
     // cleanup i.e. closing all the files
     input_file.close();
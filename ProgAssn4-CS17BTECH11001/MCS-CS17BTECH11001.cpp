@@ -11,66 +11,9 @@
 #include <algorithm>
 #include <mutex>
 #include <atomic>
+#include "QueueLocks-CS17BTECH11001.h"
 using namespace std;
 
-// QNode class
-class QNode {
-public:
-    // locked begin true indicates thread has either 
-    // acquired lock or waiting for lock
-    // false indicates that thread has released it
-    bool locked;
-    // pointer of next node since in MCS lock
-    // explicitly linked list is created 
-    QNode* next;
-
-    QNode() {
-        locked = true;
-        next = NULL;
-    }
-};
-
-// declaring thread_local my_node for threads
-static thread_local QNode* my_node = new QNode();
-
-class MCSLock {
-    // atomic tail node pointer
-    atomic<QNode*> tail;
-public:
-
-    MCSLock() {
-        // tail is initialized to NULL
-        tail.store({NULL});
-    }
-
-    // my_node is thread local node 
-    void lock() {
-        QNode* pred = atomic_exchange(&tail, my_node);
-        if(pred != NULL) {
-            my_node->locked = true;
-            pred->next = my_node;
-            while(my_node->locked) {}
-        }
-    }
-
-    // my_node is thread local node
-    void unlock() {
-        if(my_node->next == NULL) {
-            if(tail.compare_exchange_strong(my_node, NULL)) return;
-            while(my_node->next == NULL) {}
-        }
-        my_node->next->locked = false;
-        my_node->next = NULL;
-    }
-
-
-    ~MCSLock() {
-        // freeing tail pointer
-        delete tail;
-    }
-
-};
-
 
 // Critical section entry time taken by each thread
 double cs_enter_time;
@@ -100,8 +43,9 @@ BE COMMENTED.
 // test function for critical section where thread enters the CS no_of_entries times
 // and lambda_1 is average of delay for simulating CS task which is exponentially distributed
 // and similarly lambda_2 is average of delay for exit section which is also exponentially
-// distributed and my_nodes is local my_node for thread
-void testCS(int thread_id, int no_of_entries, double lambda_1, double lambda_2, MCSLock* mcs_lock) {
+// distributed
+template <class L>
+void testCS(int thread_id, int no_of_entries, double lambda_1, double lambda_2, L* mcs_lock) {
     // exponential_distribution for Critical section sleep delay
     exponential_distribution<double> exponential_1((double)1/(double)lambda_1);
     // exponential_distribution for Exit section sleep delay
@@ -153,7 +97,16 @@ void testCS(int thread_id, int no_of_entries, double lambda_1, double lambda_2,
 }
 
 
-int main() {
+int main(int argc, char* argv[]) {
+    // ./mcs churn [cycles] creates and destroys locks cycles times (default 10^6) from 4 threads
+    // which also share one lock, build with -fsanitize=address to check node ownership
+    if(argc > 1 && string(argv[1]) == "churn") {
+        long cycles = argc > 2 ? atol(argv[2]) : 1000000;
+        cout<<"MCSLock lost increments: "<<lockChurn<MCSLock>(cycles, 4, 64)<<endl;
+        cout<<"MCSParkLock lost increments: "<<lockChurn<MCSParkLock>(cycles, 4, 64)<<endl;
+        return 0;
+    }
+
     // seed for default random engine generator
     generator.seed(4);
 
@@ -180,15 +133,19 @@ int main() {
     cs_enter_time = 0;
     cs_exit_time = 0;
     output_file<<"MCS Lock Output:\n"<<flush;
+    // process cpu time before creating threads
+    clock_t cpu_start_time = clock();
 
     for(int i=0;i<no_of_threads;i++) {
-        MCS_threads[i] = thread(testCS, i, no_of_entries, lambda_1, lambda_2, mcs_lock);
+        MCS_threads[i] = thread(testCS<MCSLock>, i, no_of_entries, lambda_1, lambda_2, mcs_lock);
     }
 
     for(int i=0;i<no_of_threads;i++)
         MCS_threads[i].join();
 
 
+    // cpu time consumed by all threads in seconds
+    double cpu_time = (double)(clock() - cpu_start_time)/(double)CLOCKS_PER_SEC;
     // average cs entry time
     double average_cs_enter_time = (double)cs_enter_time/(double)(no_of_threads*no_of_entries);
     // average cs exit time
@@ -196,6 +153,35 @@ int main() {
     cout<<"MCS Lock"<<endl;
     cout<<"Average Entry time (in seconds): "<<average_cs_enter_time<<endl;
     cout<<"Average Exit time (in seconds): "<<average_cs_exit_time<<endl;
+    cout<<"CPU time consumed (in seconds): "<<cpu_time<<endl;
+
+    // initializing MCS spin-then-park Lock
+    MCSParkLock* mcs_park_lock = new MCSParkLock();
+
+    // MCS spin-then-park lock
+    cs_enter_time = 0;
+    cs_exit_time = 0;
+    output_file<<"\nMCS Spin-then-Park Lock Output:\n"<<flush;
+    cpu_start_time = clock();
+
+    for(int i=0;i<no_of_threads;i++) {
+        MCS_threads[i] = thread(testCS<MCSParkLock>, i, no_of_entries, lambda_1, lambda_2, mcs_park_lock);
+    }
+
+    for(int i=0;i<no_of_threads;i++)
+        MCS_threads[i].join();
+
+    cpu_time = (double)(clock() - cpu_start_time)/(double)CLOCKS_PER_SEC;
+    average_cs_enter_time = (double)cs_enter_time/(double)(no_of_threads*no_of_entries);
+    average_cs_exit_time = (double)cs_exit_time/(double)(no_of_threads*no_of_entries);
+    cout<<"MCS Spin-then-Park Lock"<<endl;
+    cout<<"Average Entry time (in seconds): "<<average_cs_enter_time<<endl;
+    cout<<"Average Exit time (in seconds): "<<average_cs_exit_time<<endl;
+    cout<<"CPU time consumed (in seconds): "<<cpu_time<<endl;
+
+    // freeing locks along with their nodes
+    delete mcs_lock;
+    delete mcs_park_lock;
 
     // cleanup i.e. closing all the files
     input_file.close();
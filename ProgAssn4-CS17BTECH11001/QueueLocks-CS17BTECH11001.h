@@ -0,0 +1,422 @@
+#ifndef QUEUE_LOCKS_CS17BTECH11001_H
+#define QUEUE_LOCKS_CS17BTECH11001_H
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+// CLH and MCS queue locks, spinning and spin-then-park, along with the arena which owns
+// their queue nodes, shared by the CLH, MCS and queue benchmark programs
+
+// QNode class used by CLH and MCS locks
+class QNode {
+public:
+    // locked begin true indicates thread has either
+    // acquired lock or waiting for lock
+    // false indicates that thread has released it
+    std::atomic<bool> locked;
+    // pointer of next node since in MCS lock
+    // explicitly linked list is created, unused by CLH lock
+    std::atomic<QNode*> next;
+    // position of node in the arena of its lock
+    uint32_t index;
+    // index of next node in free list of the arena
+    std::atomic<uint32_t> free_next;
+
+    QNode() {
+        locked = true;
+        next = NULL;
+    }
+};
+
+// lock owned arena of queue nodes
+// nodes are freed only along with the lock, a node which is no longer referenced
+// by any thread is recycled through a free list, so number of nodes in use is bounded
+// by the number of threads which use the lock at the same time (plus the tail node of CLH)
+template <class Node>
+class NodeArena {
+    // chunk k holds FIRST_CHUNK_SIZE*2^k nodes, so published nodes never move
+    static const uint32_t FIRST_CHUNK_SIZE = 8;
+    static const int MAX_CHUNKS = 24;
+    std::atomic<Node*> chunks[MAX_CHUNKS];
+    // number of allocated chunks, guarded by grow_lock
+    int n_chunks;
+    std::mutex grow_lock;
+    // head of free list, index of node in lower 32 bits and
+    // tag in upper 32 bits which avoids ABA on concurrent get
+    std::atomic<uint64_t> free_head;
+
+    // allocating next chunk and putting all its nodes onto free list
+    void grow() {
+        std::lock_guard<std::mutex> guard(grow_lock);
+        // some other thread may have grown arena meanwhile
+        if((uint32_t)free_head.load() != EMPTY)
+            return;
+        if(n_chunks == MAX_CHUNKS)
+            throw std::bad_alloc();
+        uint32_t size = FIRST_CHUNK_SIZE << n_chunks;
+        uint32_t first_index = FIRST_CHUNK_SIZE*((1u<<n_chunks) - 1);
+        Node* chunk = new Node[size];
+        for(uint32_t i=0;i<size;i++)
+            chunk[i].index = first_index + i;
+        chunks[n_chunks].store(chunk, std::memory_order_release);
+        n_chunks++;
+        for(uint32_t i=0;i<size;i++)
+            put(&chunk[i]);
+    }
+
+public:
+    // index marking end of free list, also used as null index by queues
+    static const uint32_t EMPTY = 0xffffffff;
+
+    NodeArena() {
+        n_chunks = 0;
+        free_head.store(EMPTY);
+    }
+
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+
+    // node at given index
+    Node* at(uint32_t index) {
+        uint32_t k = 31 - __builtin_clz(index/FIRST_CHUNK_SIZE + 1);
+        return &chunks[k].load(std::memory_order_acquire)[index - FIRST_CHUNK_SIZE*((1u<<k) - 1)];
+    }
+
+    // obtains an unused node
+    Node* get() {
+        while(true) {
+            uint64_t head = free_head.load();
+            while((uint32_t)head != EMPTY) {
+                Node* node = at((uint32_t)head);
+                uint64_t next = (((head >> 32) + 1) << 32) | node->free_next.load();
+                if(free_head.compare_exchange_weak(head, next))
+                    return node;
+            }
+            grow();
+        }
+    }
+
+    // recycles node which is not referenced by any thread any more
+    void put(Node* node) {
+        uint64_t head = free_head.load();
+        do {
+            node->free_next.store((uint32_t)head);
+        } while(!free_head.compare_exchange_weak(head, (((head >> 32) + 1) << 32) | node->index));
+    }
+
+    ~NodeArena() {
+        // freeing all the nodes
+        for(int i=0;i<n_chunks;i++)
+            delete[] chunks[i].load();
+    }
+};
+
+class CLHLock {
+public:
+    // atomic tail node pointer
+    std::atomic<QNode*> tail;
+    // arena owning all the nodes of lock
+    NodeArena<QNode> arena;
+    // node enqueued by current lock holder, written only by holder
+    QNode* holder_node;
+
+    CLHLock() {
+        QNode* tail_node = arena.get();
+        tail_node->locked = false;
+        tail.store({tail_node});
+    }
+
+    // enqueued node is taken from arena and
+    // predecessor's node is recycled once lock is acquired
+    void lock() {
+        QNode* node = arena.get();
+        node->locked = true;
+        QNode* pred = std::atomic_exchange(&tail, node);
+        while(pred->locked) {}
+        // predecessor has released pred and no other thread refers to it
+        arena.put(pred);
+        holder_node = node;
+    }
+
+    // releasing node of holder, successor recycles it
+    void unlock() {
+        holder_node->locked = false;
+    }
+
+
+    ~CLHLock() {
+        // tail node along with every other node is freed by arena
+    }
+};
+
+
+class MCSLock {
+    // atomic tail node pointer
+    std::atomic<QNode*> tail;
+    // arena owning all the nodes of lock
+    NodeArena<QNode> arena;
+    // node enqueued by current lock holder, written only by holder
+    QNode* holder_node;
+public:
+
+    MCSLock() {
+        // tail is initialized to NULL
+        tail.store({NULL});
+    }
+
+    // enqueued node is taken from arena
+    void lock() {
+        QNode* node = arena.get();
+        node->locked = true;
+        node->next = NULL;
+        QNode* pred = std::atomic_exchange(&tail, node);
+        if(pred != NULL) {
+            pred->next = node;
+            while(node->locked) {}
+        }
+        holder_node = node;
+    }
+
+    // node of holder is recycled once no other thread can refer to it
+    void unlock() {
+        QNode* node = holder_node;
+        if(node->next == NULL) {
+            // expected is a copy since compare_exchange overwrites it on failure
+            QNode* expected = node;
+            if(tail.compare_exchange_strong(expected, NULL)) {
+                arena.put(node);
+                return;
+            }
+            while(node->next == NULL) {}
+        }
+        // successor has linked itself, hence it no longer refers to node
+        node->next.load()->locked = false;
+        arena.put(node);
+    }
+
+
+    ~MCSLock() {
+        // every node is freed by arena
+    }
+
+};
+
+
+// states of the futex word of a ParkQNode
+// released by holder or predecessor, locked (held or waited for) and locked with a parked waiter
+const int RELEASED = 0;
+const int LOCKED = 1;
+const int PARKED = 2;
+
+// bounds and starting value of the adaptive spin limit
+const int MIN_SPINS = 64;
+const int MAX_SPINS = 1 << 14;
+const int INITIAL_SPINS = 1024;
+
+// QNode class for spin-then-park locks
+class ParkQNode {
+public:
+    // futex word, one of RELEASED, LOCKED or PARKED
+    std::atomic<int> locked;
+    // pointer of next node, set by successor in MCS lock, unused by CLH lock
+    std::atomic<ParkQNode*> next;
+    // position of node in the arena of its lock
+    uint32_t index;
+    // index of next node in free list of the arena
+    std::atomic<uint32_t> free_next;
+
+    ParkQNode() {
+        locked.store(LOCKED);
+        next.store(NULL);
+    }
+};
+
+// hint to the processor that thread is busy waiting
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// blocks calling thread as long as futex word is equal to value
+static inline void futexWait(std::atomic<int>* futex_word, int value) {
+    syscall(SYS_futex, reinterpret_cast<int*>(futex_word), FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+// wakes at most one thread blocked on futex word
+static inline void futexWake(std::atomic<int>* futex_word) {
+    syscall(SYS_futex, reinterpret_cast<int*>(futex_word), FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+// spins until futex word of node is released for at most spin_limit iterations and then parks
+// until it is, spin_limit moves towards twice the spins needed when spinning paid off and
+// shrinks when it was wasted
+static inline void waitForRelease(ParkQNode* node, std::atomic<int>& spin_limit) {
+    int limit = spin_limit.load(std::memory_order_relaxed);
+    for(int spins=0;spins<limit;spins++) {
+        if(node->locked.load(std::memory_order_acquire) == RELEASED) {
+            int new_limit = limit + (2*spins + MIN_SPINS - limit)/8;
+            spin_limit.store(std::min(MAX_SPINS, std::max(MIN_SPINS, new_limit)), std::memory_order_relaxed);
+            return;
+        }
+        cpuRelax();
+    }
+    spin_limit.store(std::max(MIN_SPINS, limit - limit/8), std::memory_order_relaxed);
+    while(node->locked.load(std::memory_order_acquire) != RELEASED) {
+        // announce parking so that releaser issues a wake up
+        int expected = LOCKED;
+        node->locked.compare_exchange_strong(expected, PARKED);
+        // returns immediately if node got released in between
+        futexWait(&node->locked, PARKED);
+    }
+}
+
+// CLH lock where waiter spins on predecessor for a bounded time and then
+// parks on the futex word of predecessor's node
+class CLHParkLock {
+public:
+    // atomic tail node pointer
+    std::atomic<ParkQNode*> tail;
+    // number of spins before parking, tuned on every acquire
+    std::atomic<int> spin_limit;
+    // arena owning all the nodes of lock
+    NodeArena<ParkQNode> arena;
+    // node enqueued by current lock holder, written only by holder
+    ParkQNode* holder_node;
+
+    CLHParkLock() {
+        ParkQNode* tail_node = arena.get();
+        tail_node->locked.store(RELEASED);
+        tail.store(tail_node);
+        spin_limit.store(INITIAL_SPINS);
+    }
+
+    // enqueued node is taken from arena and
+    // predecessor's node is recycled once lock is acquired
+    void lock() {
+        ParkQNode* node = arena.get();
+        node->locked.store(LOCKED);
+        ParkQNode* pred = tail.exchange(node);
+        waitForRelease(pred, spin_limit);
+        // predecessor has released pred and no other thread refers to it
+        arena.put(pred);
+        holder_node = node;
+    }
+
+    // releasing node of holder, successor recycles it
+    void unlock() {
+        ParkQNode* node = holder_node;
+        // only successor waits on node, hence only successor is woken
+        // a recycled node may get a spurious wake up which its waiter tolerates
+        if(node->locked.exchange(RELEASED) == PARKED)
+            futexWake(&node->locked);
+    }
+
+    ~CLHParkLock() {
+        // tail node along with every other node is freed by arena
+    }
+};
+
+// MCS lock where waiter spins on its own node for a bounded time and then
+// parks on the futex word of its own node
+class MCSParkLock {
+    // atomic tail node pointer
+    std::atomic<ParkQNode*> tail;
+    // number of spins before parking, tuned on every acquire
+    std::atomic<int> spin_limit;
+    // arena owning all the nodes of lock
+    NodeArena<ParkQNode> arena;
+    // node enqueued by current lock holder, written only by holder
+    ParkQNode* holder_node;
+public:
+
+    MCSParkLock() {
+        // tail is initialized to NULL
+        tail.store(NULL);
+        spin_limit.store(INITIAL_SPINS);
+    }
+
+    // enqueued node is taken from arena
+    void lock() {
+        ParkQNode* node = arena.get();
+        node->locked.store(LOCKED);
+        node->next.store(NULL);
+        ParkQNode* pred = tail.exchange(node);
+        if(pred != NULL) {
+            pred->next.store(node);
+            waitForRelease(node, spin_limit);
+        }
+        holder_node = node;
+    }
+
+    // node of holder is recycled once no other thread can refer to it
+    void unlock() {
+        ParkQNode* node = holder_node;
+        ParkQNode* succ = node->next.load();
+        if(succ == NULL) {
+            // expected is a copy since compare_exchange overwrites it on failure
+            ParkQNode* expected = node;
+            if(tail.compare_exchange_strong(expected, NULL)) {
+                arena.put(node);
+                return;
+            }
+            while((succ = node->next.load()) == NULL) cpuRelax();
+        }
+        arena.put(node);
+        // only successor waits on its node, hence only successor is woken
+        // a recycled node may get a spurious wake up which its waiter tolerates
+        if(succ->locked.exchange(RELEASED) == PARKED)
+            futexWake(&succ->locked);
+    }
+
+    ~MCSParkLock() {
+        // every node is freed by arena
+    }
+};
+
+// lifetime check of a lock type, n_threads threads each create a lock of their own, take
+// and release it twice and destroy it, cycles times in all, and take a lock shared by all
+// of them every shared_every cycles, incrementing a plain counter inside it
+// run under address sanitizer to check that nodes are neither leaked nor used after free
+// returns number of increments of shared counter which were lost, 0 if lock is correct
+template <class L>
+long lockChurn(long cycles, int n_threads, int shared_every) {
+    L* shared_lock = new L();
+    long counter = 0;
+    long per_thread = cycles/n_threads;
+    std::vector<std::thread> threads;
+    for(int i=0;i<n_threads;i++) {
+        threads.push_back(std::thread([=, &counter]() {
+            for(long c=0;c<per_thread;c++) {
+                L* own_lock = new L();
+                own_lock->lock();
+                own_lock->unlock();
+                own_lock->lock();
+                own_lock->unlock();
+                delete own_lock;
+                if(c % shared_every == 0) {
+                    shared_lock->lock();
+                    counter++;
+                    shared_lock->unlock();
+                }
+            }
+        }));
+    }
+    for(auto& t:threads)
+        t.join();
+    delete shared_lock;
+    long expected = 0;
+    for(int i=0;i<n_threads;i++)
+        expected += (per_thread + shared_every - 1)/shared_every;
+    return expected - counter;
+}
+
+#endif
@@ -0,0 +1,350 @@
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <ctime>
+#include <math.h>
+#include <unistd.h>
+#include <random>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <atomic>
+#include "QueueLocks-CS17BTECH11001.h"
+using namespace std;
+
+
+// builds counted pointer out of node index and modification count
+// counted pointers guard head and tail of Michael-Scott queue against ABA
+static inline uint64_t countedPtr(uint32_t index, uint64_t count) {
+    return (count << 32) | index;
+}
+
+// node index of counted pointer
+static inline uint32_t ptrIndex(uint64_t counted_ptr) {
+    return (uint32_t)counted_ptr;
+}
+
+// modification count of counted pointer
+static inline uint64_t ptrCount(uint64_t counted_ptr) {
+    return counted_ptr >> 32;
+}
+
+// Michael-Scott lock-free multi producer multi consumer queue
+// nodes come from an arena and are recycled through its free list, hence
+// a dequeued node is never freed while other threads may still read it
+template <class T>
+class MSQueue {
+    // MSQueue node class
+    class Node {
+    public:
+        // value is read by dequeuers which may race with recycling of node
+        atomic<T> value;
+        // counted pointer to next node
+        atomic<uint64_t> next;
+        // position of node in the arena of queue
+        uint32_t index;
+        // index of next node in free list of the arena
+        atomic<uint32_t> free_next;
+
+        Node() {
+            next.store(countedPtr(NodeArena<Node>::EMPTY, 0));
+        }
+    };
+
+    // arena owning all the nodes of queue
+    NodeArena<Node> arena;
+    // counted pointers to dummy head node and tail node
+    atomic<uint64_t> head;
+    atomic<uint64_t> tail;
+public:
+    MSQueue() {
+        Node* dummy = arena.get();
+        head.store(countedPtr(dummy->index, 0));
+        tail.store(countedPtr(dummy->index, 0));
+    }
+
+    // appending value at the tail
+    void enqueue(T value) {
+        Node* node = arena.get();
+        node->value.store(value, memory_order_relaxed);
+        uint64_t old_next = node->next.load();
+        node->next.store(countedPtr(NodeArena<Node>::EMPTY, ptrCount(old_next) + 1));
+        uint64_t last;
+        while(true) {
+            last = tail.load();
+            uint64_t next = arena.at(ptrIndex(last))->next.load();
+            // tail may have moved while next was read
+            if(last != tail.load())
+                continue;
+            if(ptrIndex(next) == NodeArena<Node>::EMPTY) {
+                // linking node after last node
+                if(arena.at(ptrIndex(last))->next.compare_exchange_weak(next, countedPtr(node->index, ptrCount(next) + 1)))
+                    break;
+            } else {
+                // tail is lagging behind, helping to swing it
+                tail.compare_exchange_weak(last, countedPtr(ptrIndex(next), ptrCount(last) + 1));
+            }
+        }
+        // swinging tail to enqueued node, fails harmlessly if some other thread helped
+        tail.compare_exchange_strong(last, countedPtr(node->index, ptrCount(last) + 1));
+    }
+
+    // removing value at the head, returns false if queue is empty
+    bool dequeue(T& value) {
+        uint64_t first;
+        while(true) {
+            first = head.load();
+            uint64_t last = tail.load();
+            uint64_t next = arena.at(ptrIndex(first))->next.load();
+            // head may have moved while next was read
+            if(first != head.load())
+                continue;
+            if(ptrIndex(first) == ptrIndex(last)) {
+                if(ptrIndex(next) == NodeArena<Node>::EMPTY)
+                    return false;
+                // tail is lagging behind, helping to swing it
+                tail.compare_exchange_weak(last, countedPtr(ptrIndex(next), ptrCount(last) + 1));
+            } else {
+                // value has to be read before head moves, next may be recycled afterwards
+                value = arena.at(ptrIndex(next))->value.load(memory_order_relaxed);
+                if(head.compare_exchange_weak(first, countedPtr(ptrIndex(next), ptrCount(first) + 1)))
+                    break;
+            }
+        }
+        // old dummy node is no longer reachable from queue
+        arena.put(arena.at(ptrIndex(first)));
+        return true;
+    }
+
+    ~MSQueue() {
+        // every node is freed by arena
+    }
+};
+
+
+// node to be embedded in items of intrusive MPSC queue
+class MPSCNode {
+public:
+    atomic<MPSCNode*> next;
+
+    MPSCNode() {
+        next.store(NULL);
+    }
+};
+
+// Vyukov intrusive lock-free multi producer single consumer queue
+// producers enqueue with one atomic exchange on tail as in MCS lock,
+// queue never allocates and items are owned by the caller
+class MPSCQueue {
+    // atomic tail node pointer, swapped by producers
+    atomic<MPSCNode*> tail;
+    // head node pointer, accessed only by the consumer
+    MPSCNode* head;
+    // stub node which keeps queue non empty
+    MPSCNode stub;
+public:
+    MPSCQueue() {
+        head = &stub;
+        tail.store(&stub);
+    }
+
+    // appending item at the tail, may be called by any thread
+    void enqueue(MPSCNode* node) {
+        node->next.store(NULL, memory_order_relaxed);
+        MPSCNode* pred = tail.exchange(node);
+        // between exchange and this store the item is invisible to consumer
+        pred->next.store(node, memory_order_release);
+    }
+
+    // removing item at the head, must be called only by the consumer
+    // returns NULL if queue is empty or a producer has not linked its item yet
+    MPSCNode* dequeue() {
+        MPSCNode* first = head;
+        MPSCNode* next = first->next.load(memory_order_acquire);
+        // skipping over stub node
+        if(first == &stub) {
+            if(next == NULL)
+                return NULL;
+            head = next;
+            first = next;
+            next = next->next.load(memory_order_acquire);
+        }
+        if(next != NULL) {
+            head = next;
+            return first;
+        }
+        // first is the last linked item, a producer may be in the middle of enqueue
+        if(first != tail.load())
+            return NULL;
+        // putting stub back behind last item so that it can be handed out
+        enqueue(&stub);
+        next = first->next.load(memory_order_acquire);
+        if(next != NULL) {
+            head = next;
+            return first;
+        }
+        return NULL;
+    }
+};
+
+
+// std::queue guarded by lock of type L which has lock and unlock methods
+template <class T, class L>
+class LockedQueue {
+    queue<T> items;
+    L items_lock;
+public:
+    // appending value at the tail
+    void enqueue(T value) {
+        items_lock.lock();
+        items.push(value);
+        items_lock.unlock();
+    }
+
+    // removing value at the head, returns false if queue is empty
+    bool dequeue(T& value) {
+        items_lock.lock();
+        bool found = !items.empty();
+        if(found) {
+            value = items.front();
+            items.pop();
+        }
+        items_lock.unlock();
+        return found;
+    }
+};
+
+
+// benchmark item which carries its enqueue time in nanoseconds
+class Item : public MPSCNode {
+public:
+    long value;
+};
+
+// start time used for enqueue timestamps
+chrono::steady_clock::time_point start;
+
+// time elapsed since start in nanoseconds
+static inline long elapsedNanos() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+}
+
+// enqueue of item's value on value based queues
+template <class Q>
+void push(Q* q, Item* item) {
+    q->enqueue(item->value);
+}
+
+// enqueue of item itself on intrusive queue
+void push(MPSCQueue* q, Item* item) {
+    q->enqueue(item);
+}
+
+// dequeue of value from value based queues
+template <class Q>
+bool pop(Q* q, long& value) {
+    return q->dequeue(value);
+}
+
+// dequeue of item from intrusive queue
+bool pop(MPSCQueue* q, long& value) {
+    MPSCNode* node = q->dequeue();
+    if(node == NULL)
+        return false;
+    value = static_cast<Item*>(node)->value;
+    return true;
+}
+
+// producer enqueues no_of_items items which are preallocated by main
+template <class Q>
+void producer(Q* q, Item* items, int no_of_items) {
+    for(int i=0;i<no_of_items;i++) {
+        items[i].value = elapsedNanos();
+        push(q, &items[i]);
+    }
+}
+
+// consumer dequeues no_of_items items and records latency from enqueue to dequeue of each item
+template <class Q>
+void consumer(Q* q, long* latencies, int no_of_items) {
+    int count = 0;
+    long value;
+    while(count < no_of_items) {
+        if(pop(q, value))
+            latencies[count++] = elapsedNanos() - value;
+        else
+            this_thread::yield();
+    }
+}
+
+// runs no_of_producers producers with no_of_items items each against no_of_consumers consumers
+// and prints throughput along with latency distribution of items
+template <class Q>
+void benchmark(string name, int no_of_producers, int no_of_consumers, int no_of_items) {
+    Q* q = new Q();
+    long total_items = (long)no_of_producers*no_of_items;
+    Item* items = new Item[total_items];
+    long* latencies = new long[total_items];
+    thread producer_threads[no_of_producers];
+    thread consumer_threads[no_of_consumers];
+
+    start = chrono::steady_clock::now();
+    // each consumer dequeues an equal share and first one takes the remainder
+    long share = total_items/no_of_consumers;
+    long offset = 0;
+    for(int i=0;i<no_of_consumers;i++) {
+        long count = share + (i == 0 ? total_items%no_of_consumers : 0);
+        consumer_threads[i] = thread(consumer<Q>, q, latencies + offset, (int)count);
+        offset += count;
+    }
+    for(int i=0;i<no_of_producers;i++)
+        producer_threads[i] = thread(producer<Q>, q, items + (long)i*no_of_items, no_of_items);
+    for(int i=0;i<no_of_producers;i++)
+        producer_threads[i].join();
+    for(int i=0;i<no_of_consumers;i++)
+        consumer_threads[i].join();
+    double duration = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count()/(double)(pow(10,6));
+
+    sort(latencies, latencies + total_items);
+    cout<<name<<" ("<<no_of_producers<<" producers, "<<no_of_consumers<<" consumers)"<<endl;
+    cout<<"Throughput (ops per second): "<<(double)total_items/duration<<endl;
+    cout<<"Latency (in microseconds) p50: "<<latencies[total_items/2]/1000.0
+        <<" p99: "<<latencies[(long)(total_items*0.99)]/1000.0
+        <<" p99.9: "<<latencies[(long)(total_items*0.999)]/1000.0
+        <<" max: "<<latencies[total_items-1]/1000.0<<endl;
+
+    delete[] latencies;
+    delete[] items;
+    delete q;
+}
+
+
+int main() {
+    // input file stream
+    ifstream input_file;
+    input_file.open("inp-params.txt");
+
+    // parameters of input file, n is used as the number of producers and
+    // consumers and k as the number of items enqueued by each producer
+    int no_of_threads, no_of_items;
+    input_file >> no_of_threads >> no_of_items;
+
+    // multiple producers and multiple consumers
+    benchmark<MSQueue<long>>("Michael-Scott Queue", no_of_threads, no_of_threads, no_of_items);
+    benchmark<LockedQueue<long, CLHLock>>("CLH Locked Queue", no_of_threads, no_of_threads, no_of_items);
+    benchmark<LockedQueue<long, MCSLock>>("MCS Locked Queue", no_of_threads, no_of_threads, no_of_items);
+    benchmark<LockedQueue<long, mutex>>("Mutex Locked Queue", no_of_threads, no_of_threads, no_of_items);
+
+    // multiple producers and single consumer
+    benchmark<MPSCQueue>("Vyukov MPSC Queue", no_of_threads, 1, no_of_items);
+    benchmark<MSQueue<long>>("Michael-Scott Queue", no_of_threads, 1, no_of_items);
+    benchmark<LockedQueue<long, CLHLock>>("CLH Locked Queue", no_of_threads, 1, no_of_items);
+    benchmark<LockedQueue<long, MCSLock>>("MCS Locked Queue", no_of_threads, 1, no_of_items);
+    benchmark<LockedQueue<long, mutex>>("Mutex Locked Queue", no_of_threads, 1, no_of_items);
+
+    // cleanup i.e. closing the file
+    input_file.close();
+    return 0;
+}
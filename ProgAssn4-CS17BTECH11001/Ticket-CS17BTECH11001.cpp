@@ -0,0 +1,199 @@
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <ctime>
+#include <math.h>
+#include <unistd.h>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <stdlib.h>
+using namespace std;
+
+// size of a cache line, counters and slots are padded to it so that waiters
+// spinning on one of them are not disturbed by writes to another
+const int CACHE_LINE = 64;
+
+// pauses per waiter ahead of a thread in the ticket queue, a thread waits about as long
+// as the threads ahead of it take to pass through the critical section
+const uint32_t BACKOFF_BASE = 256;
+
+// hint to the processor that thread is busy waiting
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// ticket lock with proportional backoff
+// a thread takes the next ticket and waits until now_serving reaches it, instead of
+// polling now_serving continuously it pauses in proportion to number of threads ahead
+class TicketLock {
+    // next ticket to hand out
+    atomic<uint32_t> next_ticket;
+    char next_ticket_padding[CACHE_LINE - sizeof(atomic<uint32_t>)];
+    // ticket of current lock holder, on its own cache line so that
+    // taking a ticket does not invalidate the line waiters poll
+    atomic<uint32_t> now_serving;
+    char now_serving_padding[CACHE_LINE - sizeof(atomic<uint32_t>)];
+public:
+
+    TicketLock() {
+        next_ticket.store(0);
+        now_serving.store(0);
+    }
+
+    void lock() {
+        uint32_t my_ticket = next_ticket.fetch_add(1, memory_order_relaxed);
+        while(true) {
+            uint32_t serving = now_serving.load(memory_order_acquire);
+            if(serving == my_ticket)
+                return;
+            // tickets wrap around, difference is still number of threads ahead
+            uint32_t ahead = my_ticket - serving;
+            for(uint32_t i=0;i<ahead*BACKOFF_BASE;i++)
+                cpuRelax();
+        }
+    }
+
+    // only holder writes now_serving, hence a plain increment suffices
+    void unlock() {
+        now_serving.store(now_serving.load(memory_order_relaxed) + 1, memory_order_release);
+    }
+};
+
+
+// Critical section entry time taken by each thread
+double cs_enter_time;
+// Critical section exit time taken by each thread
+double cs_exit_time;
+
+// output file stream
+ofstream output_file;
+
+// random number generator
+default_random_engine generator;
+
+mutex increment_lock;
+
+/***************************************************************
+TO CHECK CORRECTNESS COMMENT OUT MESSAGE 1 AND MESSAGE 4
+SINCE IF ALL MESSAGES ARE PRINTED THEN INTERLEAVING OF CHARACTER 
+MAY HAPPEN SINCE COUT DOESN'T USE LOCKS.
+FPRINTF CAN BE USED IF OUTPUT MESSAGES ARE IMPORTANT SINCE IT
+INTERNALLY USES LOCKS.
+FOR CORRECTNESS I.E. TO ENSURE MUTUAL EXCLUSION, MESSAGE 2 
+AND 3 SHOULDN'T BE INTERLEAVED. HENCE MESSAGES 1 AND 4 CAN
+BE COMMENTED.
+****************************************************************/
+
+
+// test function for critical section where thread enters the CS no_of_entries times
+// and lambda_1 is average of delay for simulating CS task which is exponentially distributed
+// and similarly lambda_2 is average of delay for exit section which is also exponentially
+// distributed
+template <class L>
+void testCS(int thread_id, int no_of_entries, double lambda_1, double lambda_2, L* ticket_lock) {
+    // exponential_distribution for Critical section sleep delay
+    exponential_distribution<double> exponential_1((double)1/(double)lambda_1);
+    // exponential_distribution for Exit section sleep delay
+    exponential_distribution<double> exponential_2((double)1/(double)lambda_2);
+    // Thread requesting to enter CS for no_of_entries times
+    // only msg 2 and msg 3 are logged, mutual exclusion holds if they never interleave
+    for(int i=0;i<no_of_entries;i++) {
+
+        // Request Entry
+        auto high_res_request_entry_time = chrono::high_resolution_clock::now();
+        
+        // Actual Entry in Critical Section
+        ticket_lock->lock();
+        auto high_res_actual_entry_time = chrono::high_resolution_clock::now();
+        time_t actual_entry_time_t = time(0);
+        tm* actual_entry_time = localtime(&actual_entry_time_t);
+        sleep(exponential_1(generator));
+        output_file<<i+1<<"th CS Entry at "<< actual_entry_time->tm_hour<<":"<<actual_entry_time->tm_min<<":"<<actual_entry_time->tm_sec<<" by thread "<<thread_id<<" (mesg 2)\n"<<flush;
+    
+        // CS enter time in seconds
+        cs_enter_time += chrono::duration_cast<chrono::microseconds>( high_res_actual_entry_time - high_res_request_entry_time ).count()/(double)(pow(10,6));
+
+        // Request Exit
+        auto high_res_request_exit_time = chrono::high_resolution_clock::now();
+        time_t request_exit_time_t = time(0);
+        tm* request_exit_time = localtime(&request_exit_time_t);
+        output_file<<i+1<<"th CS Exit Request at "<< request_exit_time->tm_hour<<":"<<request_exit_time->tm_min<<":"<<request_exit_time->tm_sec<<" by thread "<<thread_id<<" (mesg 3)\n"<<flush;
+
+        ticket_lock->unlock();
+
+        // Actual Exit 
+        auto high_res_actual_exit_time = chrono::high_resolution_clock::now();
+        
+        // CS exit time in microseconds, since it is in order of microseconds
+        // since cs_exit_time is shared variable, need to add a lock
+        // no lock needed in case of cs_entry_time since it is updated inside lock
+        increment_lock.lock();
+        cs_exit_time += chrono::duration_cast<chrono::microseconds>( high_res_actual_exit_time - high_res_request_exit_time ).count();
+        increment_lock.unlock();
+        sleep(exponential_2(generator));
+    }
+}
+
+
+
+int main() {
+    // seed for default random engine generator
+    generator.seed(4);
+
+    // input file stream
+    ifstream input_file;
+    input_file.open("inp-params.txt");
+    // output file stream
+    output_file.open("output.txt");
+
+    // parameters of input file
+    int no_of_threads, no_of_entries;
+    double lambda_1, lambda_2;
+
+    input_file >> no_of_threads >> no_of_entries >> lambda_1 >> lambda_2;
+
+    // threads for Ticket Lock
+    thread Ticket_threads[no_of_threads]; 
+
+    // initializing Ticket Lock
+    TicketLock* ticket_lock = new TicketLock();
+
+    // Ticket Lock
+    cs_enter_time = 0;
+    cs_exit_time = 0;
+    output_file<<"Ticket Lock Output:\n"<<flush;
+    // process cpu time before creating threads
+    clock_t cpu_start_time = clock();
+
+    for(int i=0;i<no_of_threads;i++) {
+        Ticket_threads[i] = thread(testCS<TicketLock>, i, no_of_entries, lambda_1, lambda_2, ticket_lock);
+    }
+
+    for(int i=0;i<no_of_threads;i++)
+        Ticket_threads[i].join();
+
+    // cpu time consumed by all threads in seconds
+    double cpu_time = (double)(clock() - cpu_start_time)/(double)CLOCKS_PER_SEC;
+    // average cs entry time
+    double average_cs_enter_time = (double)cs_enter_time/(double)(no_of_threads*no_of_entries);
+    // average cs exit time
+    double average_cs_exit_time = (double)cs_exit_time/(double)(no_of_threads*no_of_entries);
+    cout<<"Ticket Lock"<<endl;
+    cout<<"Average Entry time (in seconds): "<<average_cs_enter_time<<endl;
+    cout<<"Average Exit time (in seconds): "<<average_cs_exit_time<<endl;
+    cout<<"CPU time consumed (in seconds): "<<cpu_time<<endl;
+
+    delete ticket_lock;
+
+    // cleanup i.e. closing all the files
+    input_file.close();
+    output_file.close();
+    return 0;
+}